@@ -0,0 +1,158 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_AHOCORASICK_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_AHOCORASICK_H
+
+#include <array>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SequenceSearch.h"
+
+namespace FastaFile {
+    /// The matches of one pattern of a batch search.
+    struct PatternHits {
+        std::string name_; /// Name of the pattern (from the '>' line of the patterns file, or the pattern itself).
+        std::string pattern_; /// The subsequence searched.
+        bool reverse_ = false; /// TRUE if pattern_ is the reverse complement of the original pattern.
+        std::vector<SearchMatch> matches_; /// Every match, sorted by Sequence and offset.
+    };
+
+    /**
+     * Aho-Corasick automaton, to find many patterns (primers, adapters...) in a single pass over a text.
+     *
+     * The trie of the patterns is turned into a complete DFA (every state has a transition for every symbol of the
+     * patterns), so scanning costs one table load per base no matter how many patterns there are. Bytes that don't
+     * appear in any pattern send the automaton back to the root.
+     */
+    class AhoCorasick {
+    private:
+        std::array<int, 256> code_{}; /// Compact code of every byte (-1 if no pattern uses it).
+        int sigma_ = 0; /// Number of codes.
+        std::vector<int32_t> next_; /// Transition table, next_[state * sigma_ + code].
+        std::vector<int32_t> fail_; /// Failure link of every state.
+        std::vector<int32_t> output_; /// First pattern that ends in the state (-1 if none).
+        std::vector<int32_t> dictionary_; /// Nearest state in the failure chain with an output (-1 if none).
+        std::vector<int32_t> same_end_; /// Next pattern that ends in the same state (duplicated patterns).
+        std::vector<size_t> lengths_; /// Length of every pattern.
+
+        /// Adds an empty state and returns it.
+        int32_t newState() {
+            next_.resize(next_.size() + sigma_, -1);
+            fail_.push_back(0);
+            output_.push_back(-1);
+            dictionary_.push_back(-1);
+            return int32_t(fail_.size() - 1);
+        }
+
+    public:
+        /**
+         * Builds the automaton.
+         * @param patterns The patterns, the position in the vector is the id reported by scan().
+         */
+        explicit AhoCorasick(const std::vector<std::string> &patterns) {
+            code_.fill(-1);
+            for (const auto &pattern: patterns) {
+                for (char c: pattern) {
+                    int &code = code_[static_cast<unsigned char>(c)];
+                    if (code < 0) code = sigma_++;
+                }
+            }
+            newState();
+            same_end_.assign(patterns.size(), -1);
+            for (size_t id = 0; id < patterns.size(); id++) { //The trie.
+                lengths_.push_back(patterns[id].size());
+                if (patterns[id].empty()) continue;
+                int32_t state = 0;
+                for (char c: patterns[id]) {
+                    int code = code_[static_cast<unsigned char>(c)];
+                    if (next_[state * sigma_ + code] < 0) {
+                        int32_t created = newState();
+                        next_[state * sigma_ + code] = created;
+                    }
+                    state = next_[state * sigma_ + code];
+                }
+                same_end_[id] = output_[state];
+                output_[state] = int32_t(id);
+            }
+            std::queue<int32_t> pending; //BFS, failure links and the missing transitions of the DFA.
+            for (int code = 0; code < sigma_; code++) {
+                int32_t &child = next_[code];
+                if (child < 0) {
+                    child = 0;
+                } else {
+                    fail_[child] = 0;
+                    pending.push(child);
+                }
+            }
+            while (!pending.empty()) {
+                int32_t state = pending.front();
+                pending.pop();
+                int32_t failure = fail_[state];
+                dictionary_[state] = output_[failure] >= 0 ? failure : dictionary_[failure];
+                for (int code = 0; code < sigma_; code++) {
+                    int32_t &child = next_[state * sigma_ + code];
+                    int32_t fallback = next_[failure * sigma_ + code];
+                    if (child < 0) {
+                        child = fallback;
+                    } else {
+                        fail_[child] = fallback;
+                        pending.push(child);
+                    }
+                }
+            }
+        }
+        /**
+         * Scans a text reporting every occurrence of every pattern.
+         * @param text The text.
+         * @param found Called as found(pattern_id, offset) for every match.
+         */
+        template<typename Callback>
+        void scan(std::string_view text, Callback &&found) const {
+            int32_t state = 0;
+            for (size_t i = 0; i < text.size(); i++) {
+                int code = code_[static_cast<unsigned char>(text[i])];
+                state = code < 0 ? 0 : next_[state * sigma_ + code];
+                for (int32_t hit = output_[state] >= 0 ? state : dictionary_[state]; hit >= 0; hit = dictionary_[hit]) {
+                    for (int32_t id = output_[hit]; id >= 0; id = same_end_[id]) {
+                        found(size_t(id), i + 1 - lengths_[id]);
+                    }
+                }
+            }
+        }
+        /// Number of states of the automaton.
+        size_t statesCount() const {
+            return fail_.size();
+        }
+    };
+
+    /**
+     * Reverse complement of a DNA (IUPAC) subsequence.
+     * @param pattern The subsequence.
+     * @return The reverse complement, symbols without complement (N, X, -, ...) are kept.
+     */
+    inline std::string reverseComplement(const std::string &pattern) {
+        static const std::array<char, 256> complement = [] {
+            std::array<char, 256> table{};
+            for (int c = 0; c < 256; c++) table[c] = char(c);
+            const char pairs[][2] = {{'A', 'T'}, {'C', 'G'}, {'U', 'A'}, {'R', 'Y'}, {'K', 'M'}, {'B', 'V'}, {'D', 'H'}};
+            for (auto &pair: pairs) {
+                table[static_cast<unsigned char>(pair[0])] = pair[1];
+                if (pair[0] != 'U') table[static_cast<unsigned char>(pair[1])] = pair[0];
+                table[static_cast<unsigned char>(pair[0] + 32)] = char(pair[1] + 32); // Lowercase (soft-masked).
+                if (pair[0] != 'U') table[static_cast<unsigned char>(pair[1] + 32)] = char(pair[0] + 32);
+            }
+            return table;
+        }();
+        std::string reversed(pattern.rbegin(), pattern.rend());
+        for (char &c: reversed) c = complement[static_cast<unsigned char>(c)];
+        return reversed;
+    }
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_AHOCORASICK_H
@@ -0,0 +1,71 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_ALLOCATIONCOUNTER_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace FastaFile {
+    /// Heap allocations made by the program so far.
+    struct AllocationCount {
+        uint64_t allocations_ = 0; /// Calls to operator new.
+        uint64_t bytes_ = 0; /// Bytes asked for.
+    };
+
+    inline std::atomic<uint64_t> allocations_made{0}; /// Calls to operator new (see FASTA_COUNT_ALLOCATIONS).
+    inline std::atomic<uint64_t> bytes_allocated{0}; /// Bytes asked to operator new.
+
+    /// TRUE if the program counts its allocations (it was built with FASTA_COUNT_ALLOCATIONS).
+    inline bool allocationsCounted() {
+#ifdef FASTA_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// The allocations made so far (always zero if they are not counted).
+    inline AllocationCount allocationCount() {
+        return {allocations_made.load(std::memory_order_relaxed), bytes_allocated.load(std::memory_order_relaxed)};
+    }
+}
+
+#ifdef FASTA_COUNT_ALLOCATIONS
+/*
+ * Replacements of the global operator new / delete that count every allocation (two relaxed atomic adds each).
+ * They must be defined once in the program, and only in a bench build (g++ -DFASTA_COUNT_ALLOCATIONS main.cpp):
+ * every allocation of every thread would touch the same two counters.
+ * The array and nothrow forms call these ones. They are kept out of line, so the compiler doesn't match an
+ * inlined malloc against the delete of the standard library.
+ */
+#if defined(__GNUC__)
+#define FASTA_ALLOCATOR_NOINLINE __attribute__((noinline))
+#else
+#define FASTA_ALLOCATOR_NOINLINE
+#endif
+
+FASTA_ALLOCATOR_NOINLINE void *operator new(std::size_t size) {
+    FastaFile::allocations_made.fetch_add(1, std::memory_order_relaxed);
+    FastaFile::bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+    void *block = std::malloc(size == 0 ? 1 : size);
+    if (block == nullptr) throw std::bad_alloc();
+    return block;
+}
+
+FASTA_ALLOCATOR_NOINLINE void operator delete(void *block) noexcept {
+    std::free(block);
+}
+
+FASTA_ALLOCATOR_NOINLINE void operator delete(void *block, std::size_t) noexcept {
+    std::free(block);
+}
+#endif
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_ALLOCATIONCOUNTER_H
@@ -0,0 +1,158 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_BASEALPHABET_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_BASEALPHABET_H
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace DNA_sequence {
+    /// The alphabets a File can be validated with.
+    enum class AlphabetKind {
+        Default, /// IUPAC nucleotides plus 'X' (masked) and '-' (gap), the original list of the project.
+        DNA, /// A, C, G, T, N and '-'.
+        RNA, /// A, C, G, U, N and '-'.
+        IUPAC, /// Every IUPAC nucleotide code and '-'.
+        Protein /// IUPAC amino acids, '*' (stop) and '-'.
+    };
+
+    /**
+     * Set of valid symbols, checked with a 256-entry lookup table.
+     *
+     * The tables are built at compile time, checking a char is a single load. validPrefix() also has a SIMD fast
+     * path (16 bytes per instruction with SSE2, 32 with AVX2) for runs of pure A/C/G/T, which is what most DNA lines
+     * are made of; any other block falls back to the table. '\r' is always valid, so files with CRLF line-breaks
+     * still load.
+     */
+    class BaseAlphabet {
+    private:
+        std::array<bool, 256> table_{}; /// TRUE for every valid symbol.
+        bool acgt_fast_path_ = false; /// TRUE if A, C, G and T are valid (the SIMD path can be used).
+
+        /// Builds the table with the given symbols.
+        constexpr explicit BaseAlphabet(const char *symbols) {
+            for (const char *it = symbols; *it != '\0'; ++it) {
+                table_[static_cast<unsigned char>(*it)] = true;
+            }
+            acgt_fast_path_ = table_['A'] && table_['C'] && table_['G'] && table_['T'];
+        }
+
+    public:
+#if defined(__AVX2__)
+        /// Number of leading bytes that are all A/C/G/T, checked 32 at a time.
+        static size_t acgtPrefix(const char *data, size_t size) {
+            const __m256i a = _mm256_set1_epi8('A'), c = _mm256_set1_epi8('C');
+            const __m256i g = _mm256_set1_epi8('G'), t = _mm256_set1_epi8('T');
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, a), _mm256_cmpeq_epi8(block, c)),
+                                               _mm256_or_si256(_mm256_cmpeq_epi8(block, g), _mm256_cmpeq_epi8(block, t)));
+                if (uint32_t(_mm256_movemask_epi8(hits)) != 0xFFFFFFFFu) break;
+            }
+            return i;
+        }
+#elif defined(__SSE2__)
+        /// Number of leading bytes that are all A/C/G/T, checked 16 at a time.
+        static size_t acgtPrefix(const char *data, size_t size) {
+            const __m128i a = _mm_set1_epi8('A'), c = _mm_set1_epi8('C');
+            const __m128i g = _mm_set1_epi8('G'), t = _mm_set1_epi8('T');
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, a), _mm_cmpeq_epi8(block, c)),
+                                            _mm_or_si128(_mm_cmpeq_epi8(block, g), _mm_cmpeq_epi8(block, t)));
+                if (_mm_movemask_epi8(hits) != 0xFFFF) break;
+            }
+            return i;
+        }
+#else
+        /// Without SIMD there's no fast path, the table does all the work.
+        static size_t acgtPrefix(const char *, size_t) {
+            return 0;
+        }
+#endif
+        /**
+         * Returns the (static) alphabet of the given kind.
+         * @param kind The alphabet.
+         * @return The alphabet, valid for the whole program.
+         */
+        static const BaseAlphabet &get(AlphabetKind kind) {
+            static constexpr BaseAlphabet default_("ACGTURYKMSWBDHVNX-\r");
+            static constexpr BaseAlphabet dna_("ACGTN-\r");
+            static constexpr BaseAlphabet rna_("ACGUN-\r");
+            static constexpr BaseAlphabet iupac_("ACGTURYKMSWBDHVN-\r");
+            static constexpr BaseAlphabet protein_("ABCDEFGHIKLMNPQRSTUVWXYZ*-\r");
+            switch (kind) {
+                case AlphabetKind::DNA:
+                    return dna_;
+                case AlphabetKind::RNA:
+                    return rna_;
+                case AlphabetKind::IUPAC:
+                    return iupac_;
+                case AlphabetKind::Protein:
+                    return protein_;
+                default:
+                    return default_;
+            }
+        }
+        /**
+         * Given a Char, check if is a valid symbol.
+         * @param c The char to valid.
+         * @return TRUE if the char is valid.
+         */
+        bool valid(char c) const {
+            return table_[static_cast<unsigned char>(c)];
+        }
+        /**
+         * Length of the longest prefix of valid symbols.
+         * @param data First char to check.
+         * @param size Number of chars.
+         * @return size if every char is valid, otherwise the position of the first invalid one.
+         */
+        size_t validPrefix(const char *data, size_t size) const {
+            size_t i = 0;
+            while (i < size) {
+                if (acgt_fast_path_) i += acgtPrefix(data + i, size - i);
+                size_t stop = std::min(size, i + 32); // Scalar step over the block that left the fast path.
+                for (; i < stop; ++i) {
+                    if (!table_[static_cast<unsigned char>(data[i])]) return i;
+                }
+            }
+            return size;
+        }
+        /**
+         * Checks the chars once in uppercase, so soft-masked (lowercase) bases are valid too.
+         * @param data First char to check.
+         * @param size Number of chars.
+         * @return TRUE if every char is valid in uppercase.
+         */
+        bool validFolded(const char *data, size_t size) const {
+            for (size_t i = 0; i < size; i++) {
+                if (!table_[static_cast<unsigned char>(toupper(static_cast<unsigned char>(data[i])))]) return false;
+            }
+            return true;
+        }
+        /// Every valid symbol, in ASCII order.
+        std::list<char> symbols() const {
+            std::list<char> symbols_list;
+            for (int c = 0; c < 256; c++) {
+                if (table_[c]) symbols_list.push_back(char(c));
+            }
+            return symbols_list;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_BASEALPHABET_H
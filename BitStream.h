@@ -0,0 +1,124 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_BITSTREAM_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_BITSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Writes variable-length codes (MSB first) into 64-bit words.
+ *
+ * The codes are appended to a 64-bit accumulator with a shift and an OR, and only whole words are pushed to the
+ * output buffer, so writing a code never touches memory bit by bit. flush() pads the last word with zeros.
+ */
+class BitWriter {
+private:
+    std::vector<uint64_t> &words_; /// The output buffer.
+    uint64_t accumulator_ = 0; /// Bits not yet written, right aligned.
+    unsigned used_ = 0; /// Bits in the accumulator (always < 64).
+    uint64_t bits_ = 0; /// Total of bits written.
+
+public:
+    /**
+     * Constructor.
+     * @param words The buffer where the words are appended.
+     */
+    explicit BitWriter(std::vector<uint64_t> &words) : words_(words) {}
+    /**
+     * Appends a code.
+     * @param code The code, right aligned.
+     * @param length Number of bits of the code (1 to 64).
+     */
+    void put(uint64_t code, unsigned length) {
+        bits_ += length;
+        unsigned free = 64 - used_;
+        if (length < free) {
+            accumulator_ = (accumulator_ << length) | code;
+            used_ += length;
+            return;
+        }
+        unsigned rest = length - free; // Bits that go to the next word.
+        uint64_t word = free == 64 ? 0 : accumulator_ << free;
+        words_.push_back(word | (code >> rest));
+        accumulator_ = rest == 0 ? 0 : code & ((uint64_t(1) << rest) - 1);
+        used_ = rest;
+    }
+    /// Writes the last (incomplete) word, padded with zeros.
+    void flush() {
+        if (used_ > 0) {
+            words_.push_back(accumulator_ << (64 - used_));
+            accumulator_ = 0;
+            used_ = 0;
+        }
+    }
+    /// Total of bits written.
+    uint64_t bits() const {
+        return bits_;
+    }
+};
+
+/**
+ * Reads the bits written by a BitWriter.
+ */
+class BitReader {
+private:
+    const uint64_t *words_; /// The words.
+    size_t count_; /// Number of words.
+    size_t position_ = 0; /// Next bit to read.
+
+public:
+    /**
+     * Constructor.
+     * @param words The words.
+     * @param count Number of words.
+     */
+    BitReader(const uint64_t *words, size_t count) : words_(words), count_(count) {}
+    /// Reads a single bit.
+    unsigned bit() {
+        size_t word = position_ >> 6;
+        unsigned shift = 63 - unsigned(position_ & 63);
+        position_++;
+        return word < count_ ? unsigned((words_[word] >> shift) & 1) : 0;
+    }
+    /**
+     * The 64 bits that follow a bit position, left aligned (zeros past the end).
+     * At most two word loads, whatever the bit position is.
+     * @param words The words.
+     * @param count Number of words.
+     * @param position The first bit.
+     */
+    static uint64_t windowAt(const uint64_t *words, size_t count, size_t position) {
+        size_t word = position >> 6;
+        unsigned offset = unsigned(position & 63);
+        uint64_t high = word < count ? words[word] : 0;
+        uint64_t low = word + 1 < count ? words[word + 1] : 0;
+        return (high << offset) | ((low >> 1) >> (63 - offset)); //No shift by 64 when offset == 0.
+    }
+    /// The next 64 bits, left aligned, without consuming them.
+    uint64_t window() const {
+        return windowAt(words_, count_, position_);
+    }
+    /// The words.
+    const uint64_t *words() const {
+        return words_;
+    }
+    /// Number of words.
+    size_t count() const {
+        return count_;
+    }
+    /// Consumes bits already looked at with window().
+    void skip(size_t length) {
+        position_ += length;
+    }
+    /// Bits read so far.
+    size_t position() const {
+        return position_;
+    }
+};
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_BITSTREAM_H
@@ -0,0 +1,132 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_CONTEXTHUFFMAN_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_CONTEXTHUFFMAN_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BitStream.h"
+#include "Huffman.h"
+
+/**
+ * Order-2 context model with Huffman codes: every base is coded with the table of the two bases before it.
+ *
+ * The previous bases are reduced to 5 classes (A, C, G, T upper or lowercase, and anything else), so a block
+ * has 25 contexts, each one with its own histogram and its own canonical code (only the code lengths are stored,
+ * a few bytes per context). It catches what a single table can't, like the dinucleotide bias (CpG depletion) or
+ * the N runs, where an N after two N's takes a single bit. Decoding switches table at every base, so it's slower
+ * than the order-0 codecs.
+ */
+class ContextHuffman {
+public:
+    static constexpr unsigned kClasses = 5; /// Classes of a previous base.
+    static constexpr unsigned kContexts = kClasses * kClasses; /// Contexts of a base (the two previous classes).
+
+private:
+    /// The class of every byte: A/a = 0, C/c = 1, G/g = 2, T/t = 3, anything else = 4.
+    static const std::array<uint8_t, 256> &classes() {
+        static const std::array<uint8_t, 256> table = [] {
+            std::array<uint8_t, 256> base_class{};
+            base_class.fill(kClasses - 1);
+            const char acgt[] = "ACGT";
+            for (uint8_t i = 0; i < 4; i++) {
+                base_class[static_cast<unsigned char>(acgt[i])] = i;
+                base_class[static_cast<unsigned char>(acgt[i] + ('a' - 'A'))] = i;
+            }
+            return base_class;
+        }();
+        return table;
+    }
+    /// The context after a base (the first base of a block has the context of two "other" bases).
+    static unsigned nextContext(unsigned context, unsigned char base, const std::array<uint8_t, 256> &base_class) {
+        return (context % kClasses) * kClasses + base_class[base];
+    }
+
+public:
+    /**
+     * Encodes the bases: the code lengths of every context, zeros up to a multiple of 8 bytes, then the codes.
+     * @param residues The bases.
+     * @param payload [out] The encoded bases.
+     */
+    static void encode(std::string_view residues, std::string &payload) {
+        const std::array<uint8_t, 256> &base_class = classes();
+        std::vector<uint64_t> frequency(size_t(kContexts) * 256);
+        unsigned context = kContexts - 1;
+        for (char c: residues) {
+            auto base = static_cast<unsigned char>(c);
+            frequency[context * 256 + base]++;
+            context = nextContext(context, base, base_class);
+        }
+        std::vector<HuffmanCodeTable> tables;
+        tables.reserve(kContexts);
+        for (unsigned i = 0; i < kContexts; i++) {
+            tables.emplace_back(&frequency[i * 256]);
+            appendCodeLengths(payload, tables.back().lengths());
+        }
+        payload.resize((payload.size() + 7) / 8 * 8, '\0');
+        std::vector<uint64_t> words;
+        words.reserve(residues.size() / 16 + 1);
+        BitWriter writer(words);
+        context = kContexts - 1;
+        for (char c: residues) {
+            auto base = static_cast<unsigned char>(c);
+            uint32_t entry = tables[context].packed(base);
+            writer.put(entry >> 8, entry & 0xff);
+            context = nextContext(context, base, base_class);
+        }
+        writer.flush();
+        payload.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t));
+    }
+    /**
+     * Decodes the bases written by encode.
+     * @param payload The encoded bases (8-byte aligned).
+     * @param size Bytes of the payload.
+     * @param out [out] The bases.
+     * @param count Number of bases.
+     * @return FALSE if the payload is not valid.
+     */
+    static bool decode(const char *payload, size_t size, char *out, size_t count) {
+        const std::array<uint8_t, 256> &base_class = classes();
+        const char *cursor = payload, *end = payload + size;
+        std::vector<HuffmanSymbolDecoder> decoders;
+        decoders.reserve(kContexts);
+        for (unsigned i = 0; i < kContexts; i++) {
+            uint8_t length[256];
+            cursor = readCodeLengths(cursor, end, length);
+            if (cursor == nullptr) return false;
+            decoders.emplace_back(length);
+        }
+        size_t header = (size_t(cursor - payload) + 7) / 8 * 8;
+        if (header > size) return false;
+        auto words = reinterpret_cast<const uint64_t *>(payload + header);
+        const size_t words_count = (size - header) / sizeof(uint64_t);
+        const size_t fast_end = words_count > 1 ? (words_count - 1) * 64 : 0; //Below it both words can be read.
+        size_t position = 0;
+        unsigned context = kContexts - 1;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t window;
+            if (position < fast_end) {
+                unsigned offset = unsigned(position & 63);
+                window = (words[position >> 6] << offset) | ((words[(position >> 6) + 1] >> 1) >> (63 - offset));
+            } else {
+                window = BitReader::windowAt(words, words_count, position);
+            }
+            unsigned char base = 0;
+            uint8_t bits = decoders[context].decode(window, base);
+            if (bits == 0 || position + bits > words_count * 64) return false;
+            out[i] = char(base);
+            position += bits;
+            context = nextContext(context, base, base_class);
+        }
+        return true;
+    }
+};
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_CONTEXTHUFFMAN_H
@@ -0,0 +1,993 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_FABINCONTAINER_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_FABINCONTAINER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BitStream.h"
+#include "ContextHuffman.h"
+#include "Histogram.h"
+#include "Huffman.h"
+#include "IoPipeline.h"
+#include "MappedFile.h"
+#include "Region.h"
+#include "Parallel.h"
+#include "Rans.h"
+#include "RunLength.h"
+#include "Sequence.h"
+#include "TwoBitCodec.h"
+
+namespace FastaFile {
+    constexpr char kFabinMagic[4] = {'F', 'A', 'B', 'N'}; /// First bytes of every .fabin file.
+    constexpr char kFabinIndexMagic[4] = {'F', 'A', 'B', 'I'}; /// Last bytes of every .fabin file.
+    constexpr uint8_t kFabinVersion = 6; /// Version of the .fabin layout written by FabinWriter.
+    constexpr uint32_t kFabinBlockBases = uint32_t(1) << 18; /// Bases per block (256 KB before compression).
+
+    /// How the bases of a .fabin File are encoded (stored in its header).
+    enum class FabinCodec : uint8_t {
+        Huffman = 0, /// Canonical Huffman codes, for any alphabet.
+        TwoBit = 1, /// 2 bits per A/C/G/T, run lists for everything else (see TwoBitCodec).
+        BlockHuffman = 2, /// Huffman, with its own table in every block where that takes fewer bytes.
+        ContextHuffman = 3, /// Like BlockHuffman, or tables per order-2 context where smaller (see ContextHuffman).
+        Rans = 4 /// Interleaved rANS, with the frequencies of every block (see RansCodec).
+    };
+
+    /// TRUE if the codec uses the code table of the File (stored in the header).
+    inline bool codecUsesTable(FabinCodec codec) {
+        return codec != FabinCodec::TwoBit && codec != FabinCodec::Rans;
+    }
+
+    /**
+     * CRC-32 (the zlib/PNG polynomial) of a buffer, table driven.
+     * @param data The first byte.
+     * @param size Number of bytes.
+     * @return The checksum.
+     */
+    inline uint32_t crc32(const char *data, size_t size) {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> crc_table{};
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                crc_table[n] = c;
+            }
+            return crc_table;
+        }();
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++) crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    /// An independently compressed slice of the residues of one Sequence.
+    struct FabinBlock {
+        uint64_t offset_; /// Position of the payload in the file (8-byte aligned).
+        uint64_t size_; /// Bytes of the payload.
+        uint32_t bases_; /// Bytes of residues it decodes to.
+        uint32_t checksum_; /// CRC-32 of the payload.
+    };
+
+    /// A line of the .fa that is not a DNA Line (kept as it was, see FabinWriter::addOtherLine).
+    struct FabinLine {
+        uint64_t after_; /// DNA Lines of the Sequence before it.
+        std::string text_; /// The line, without its line-break.
+    };
+
+    /// What the index of a .fabin File knows about a Sequence.
+    struct FabinSequence {
+        std::string name_; /// The name (rest of the '>' line).
+        int64_t max_length_ = 0; /// Longest DNA Line.
+        int64_t lines_count_ = 0; /// Number of DNA Lines.
+        std::vector<uint64_t> length_runs_; /// (length, repeats) pairs of the DNA Lines.
+        std::vector<uint64_t> lowercase_runs_; /// (start, length) pairs of the soft-masked residues.
+        std::vector<FabinLine> other_lines_; /// The other lines after the '>' line, in order.
+        bool crlf_ = false; /// TRUE if every DNA Line ends with a '\r' (kept in the residues).
+        uint64_t residues_ = 0; /// Bytes of residues (bases, plus the '\r' of CRLF lines).
+        uint32_t first_block_ = 0; /// First block of the Sequence.
+        uint32_t blocks_count_ = 0; /// Number of blocks.
+
+        /// The length of every DNA Line.
+        std::vector<uint64_t> lineLengths() const {
+            std::vector<uint64_t> lengths;
+            for (size_t run = 0; run + 1 < length_runs_.size(); run += 2) {
+                lengths.insert(lengths.end(), size_t(length_runs_[run + 1]), length_runs_[run]);
+            }
+            return lengths;
+        }
+        /**
+         * Puts the soft-masked residues of a slice back in lowercase (the blocks hold them in uppercase).
+         * @param offset Position of the slice in the residues.
+         * @param data [in, out] The slice.
+         * @param size Bytes of the slice.
+         */
+        void applyLowercase(uint64_t offset, char *data, size_t size) const {
+            size_t low = 0, high = lowercase_runs_.size() / 2; //First run that ends after offset.
+            while (low < high) {
+                size_t middle = (low + high) / 2;
+                if (lowercase_runs_[2 * middle] + lowercase_runs_[2 * middle + 1] <= offset) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            for (size_t run = low; run < lowercase_runs_.size() / 2 && lowercase_runs_[2 * run] < offset + size; run++) {
+                uint64_t from = std::max(lowercase_runs_[2 * run], offset) - offset;
+                uint64_t to = std::min(lowercase_runs_[2 * run] + lowercase_runs_[2 * run + 1], offset + size) - offset;
+                for (uint64_t i = from; i < to; i++) data[i] = char(tolower(static_cast<unsigned char>(data[i])));
+            }
+        }
+        /// Number of bases (line-breaks don't count).
+        uint64_t basesCount() const {
+            return crlf_ ? residues_ - uint64_t(lines_count_) : residues_;
+        }
+        /// Position in the residues of a base offset (or of the end, for basesCount()).
+        uint64_t residuesOffset(uint64_t base) const {
+            if (!crlf_) return base;
+            uint64_t position = 0;
+            for (size_t run = 0; run + 1 < length_runs_.size(); run += 2) {
+                uint64_t bases_per_line = length_runs_[run] - 1, lines = length_runs_[run + 1];
+                if (bases_per_line > 0 && base < bases_per_line * lines) {
+                    return position + (base / bases_per_line) * (bases_per_line + 1) + base % bases_per_line;
+                }
+                base -= bases_per_line * lines;
+                position += (bases_per_line + 1) * lines;
+            }
+            return position;
+        }
+    };
+
+    /// Appends the raw bytes of a value to a buffer.
+    template<typename T>
+    void appendValue(std::string &buffer, const T &value) {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    /// Appends a text to a buffer: its uint64 size, then its bytes.
+    inline void appendText(std::string &buffer, std::string_view text) {
+        appendValue(buffer, uint64_t(text.size()));
+        buffer.append(text.data(), text.size());
+    }
+
+    /// Reads raw values from a buffer, with bounds checking.
+    class ByteCursor {
+    private:
+        const char *position_; /// Next byte.
+        const char *end_; /// One past the last byte.
+        bool ok_ = true; /// FALSE once a read went past the end.
+    public:
+        ByteCursor(const char *begin, const char *end) : position_(begin), end_(end) {}
+        /// Reads a value (zero if there are not enough bytes left).
+        template<typename T>
+        T read() {
+            T value{};
+            if (size_t(end_ - position_) < sizeof(T)) {
+                ok_ = false;
+                position_ = end_;
+                return value;
+            }
+            memcpy(&value, position_, sizeof(T));
+            position_ += sizeof(T);
+            return value;
+        }
+        /// Takes a number of bytes (nullptr if there are not enough bytes left).
+        const char *take(size_t size) {
+            if (size_t(end_ - position_) < size) {
+                ok_ = false;
+                position_ = end_;
+                return nullptr;
+            }
+            const char *taken = position_;
+            position_ += size;
+            return taken;
+        }
+        /// Reads a text written by appendText (empty if there are not enough bytes left).
+        std::string readText() {
+            auto size = read<uint64_t>();
+            const char *text = take(size_t(std::min<uint64_t>(size, SIZE_MAX)));
+            return text != nullptr ? std::string(text, size_t(size)) : std::string();
+        }
+        /// Reads count uint64 values (nothing if there are not enough bytes left).
+        void readValues(uint64_t count, std::vector<uint64_t> &values) {
+            const char *data = take(count > SIZE_MAX / sizeof(uint64_t) ? SIZE_MAX : size_t(count) * sizeof(uint64_t));
+            if (data == nullptr || count == 0) return;
+            values.resize(size_t(count));
+            memcpy(values.data(), data, values.size() * sizeof(uint64_t));
+        }
+        /// FALSE if a read went past the end.
+        bool ok() const {
+            return ok_;
+        }
+    };
+
+    /**
+     * Writes a block-structured .fabin File.
+     *
+     * Layout: a header (magic, version, codec, code lengths, bases per block), the block payloads (each one
+     * compressed on its own and 8-byte aligned), the index (every Sequence with its DNA Lines and blocks, every
+     * block with its offset, size and CRC-32) and a trailer with the offset of the index. Blocks never span two
+     * Sequences, so any region can be decoded from the one or two blocks that hold it. The code lengths of the
+     * header are stored by the codecs that use the table of the File (see codecUsesTable); the blocks of the
+     * BlockHuffman and ContextHuffman codecs may carry their own tables (see encodeBases), the ones of the Rans codec
+     * always do. Except with TwoBit, every block starts with its long runs of one byte, which are not coded.
+     * The blocks hold the DNA Lines in uppercase; the index keeps the soft-masked (lowercase) ranges and every
+     * line that is not a DNA Line, so the .fa comes back byte by byte (see FabinReader::writeFasta).
+     *
+     * The blocks are queued and encoded in batches by the thread pool, then written in their original order.
+     * A Sequence is added either at once (addSequence) or line by line (beginSequence, addLine, endSequence),
+     * which only keeps the current batch in memory, so a File of any size can be compressed as it's read.
+     */
+    class FabinWriter {
+    private:
+        OutputPipeline output_; /// The file, written behind by its own thread.
+        FabinCodec codec_; /// How the blocks are encoded.
+        HuffmanCodeTable code_table_; /// The codes of the File (see codecUsesTable).
+        uint32_t block_bases_; /// Bytes of residues per block.
+        uint64_t position_ = 0; /// Bytes written so far.
+        std::vector<FabinSequence> sequences_; /// The index.
+        std::vector<FabinBlock> blocks_; /// The index of the blocks.
+        unsigned threads_; /// Threads used to encode.
+        std::vector<std::string_view> pending_; /// Blocks queued, not encoded yet.
+        size_t pending_bytes_ = 0; /// Bytes of residues queued.
+        std::deque<std::string> owned_; /// Residues of the queued blocks that were added line by line.
+        std::string current_; /// Block being filled line by line.
+        FabinSequence streaming_; /// Sequence being added line by line.
+        bool in_sequence_ = false; /// TRUE between beginSequence and endSequence.
+        std::vector<std::string> preamble_; /// Lines before the first Sequence (see addOtherLine).
+        bool line_break_at_end_ = true; /// FALSE if the last line of the .fa had no line-break.
+        std::vector<std::string> payloads_; /// Encoded blocks of a batch (reused).
+        bool encoded_ = true; /// FALSE once a block could not be encoded (a base without a code).
+        static constexpr size_t kBatchBytes = size_t(64) << 20; /// Residues encoded per batch.
+
+        /// Writes raw bytes.
+        void write(const char *data, size_t size) {
+            output_.write(data, size);
+            position_ += size;
+        }
+        /// Pads with zeros up to a multiple of 8 bytes.
+        void align() {
+            static const char zeros[8] = {};
+            if (position_ % 8 != 0) write(zeros, 8 - position_ % 8);
+        }
+        /// Encodes the queued blocks in parallel and writes them in order.
+        void flush() {
+            payloads_.resize(pending_.size());
+            std::atomic<bool> encoded{true};
+            parallelFor(pending_.size(), [&](size_t index, unsigned) {
+                if (!encodeBlock(codec_, code_table_, pending_[index], payloads_[index])) encoded = false;
+            }, threads_);
+            encoded_ = encoded_ && encoded;
+            for (size_t i = 0; i < pending_.size(); i++) {
+                const std::string &payload = payloads_[i];
+                align();
+                blocks_.push_back({position_, payload.size(), uint32_t(pending_[i].size()),
+                                   crc32(payload.data(), payload.size())});
+                write(payload.data(), payload.size());
+            }
+            pending_.clear();
+            pending_bytes_ = 0;
+            owned_.clear();
+        }
+        /// Queues a block.
+        void queue(std::string_view residues) {
+            pending_.push_back(residues);
+            pending_bytes_ += residues.size();
+            if (pending_bytes_ >= kBatchBytes) flush();
+        }
+        /// Queues the block being filled line by line.
+        void queueCurrent() {
+            owned_.push_back(std::move(current_));
+            current_.clear();
+            current_.reserve(block_bases_);
+            streaming_.blocks_count_++;
+            queue(owned_.back());
+        }
+        /// Adds a DNA Line to the line-length runs of a Sequence.
+        static void countLine(FabinSequence &entry, std::string_view line) {
+            entry.lines_count_++;
+            entry.crlf_ = entry.crlf_ && !line.empty() && line.back() == '\r';
+            std::vector<uint64_t> &runs = entry.length_runs_;
+            if (!runs.empty() && runs[runs.size() - 2] == line.size()) {
+                runs.back()++;
+            } else {
+                runs.push_back(line.size());
+                runs.push_back(1);
+            }
+        }
+        /// Adds the lowercase bytes of a DNA Line (at the given position of the residues) to the runs of a Sequence.
+        static void countLowercase(FabinSequence &entry, uint64_t position, std::string_view line) {
+            std::vector<uint64_t> &runs = entry.lowercase_runs_;
+            for (size_t i = 0; i < line.size(); i++) {
+                if (!islower(static_cast<unsigned char>(line[i]))) continue;
+                size_t j = i + 1;
+                while (j < line.size() && islower(static_cast<unsigned char>(line[j]))) j++;
+                if (!runs.empty() && runs[runs.size() - 2] + runs.back() == position + i) {
+                    runs.back() += j - i; //Goes on from the line before.
+                } else {
+                    runs.push_back(position + i);
+                    runs.push_back(j - i);
+                }
+                i = j;
+            }
+        }
+
+    public:
+        /**
+         * Creates the file and writes the header.
+         * @param file_name The file.
+         * @param codec How the blocks are encoded.
+         * @param code_table The Huffman codes (only stored by the codecs that use them, see codecUsesTable).
+         * @param threads Threads used to encode (0 = defaultThreads()).
+         * @param block_bases Bytes of residues per block.
+         */
+        FabinWriter(const std::string &file_name, FabinCodec codec, const HuffmanCodeTable &code_table,
+                    unsigned threads = 0, uint32_t block_bases = kFabinBlockBases)
+                : output_(file_name), codec_(codec), code_table_(code_table),
+                  block_bases_(std::max<uint32_t>(block_bases, 64)), threads_(threads) {
+            std::string header(kFabinMagic, sizeof(kFabinMagic));
+            appendValue(header, kFabinVersion);
+            appendValue(header, codec_);
+            const uint8_t no_codes[256] = {};
+            appendCodeLengths(header, codecUsesTable(codec_) ? code_table_.lengths() : no_codes); //Only the lengths.
+            appendValue(header, block_bases_);
+            write(header.data(), header.size());
+        }
+        /// TRUE if the file can be written.
+        bool good() const {
+            return output_.good();
+        }
+        /**
+         * Encodes a slice of residues as a block payload.
+         *
+         * With every codec but TwoBit (which keeps its own run lists) the payload starts with the long runs of
+         * the slice (see RunLength): a uint32 count, then (uint32 start, uint32 length, byte) for each one, and
+         * zeros up to a multiple of 8 bytes. The rest of the bytes follow, coded by the codec (see encodeBases).
+         * @param codec How the block is encoded.
+         * @param code_table The Huffman codes.
+         * @param residues The slice.
+         * @param payload [out] The encoded block.
+         * @return FALSE if a base has no code in the table (see HuffmanCodeTable::encode).
+         */
+        static bool encodeBlock(FabinCodec codec, const HuffmanCodeTable &code_table, std::string_view residues,
+                                std::string &payload) {
+            payload.clear();
+            if (codec == FabinCodec::TwoBit) return encodeBases(codec, code_table, residues, payload);
+            std::vector<BaseRun> runs;
+            std::string rest;
+            std::string_view coded = RunLength::split(residues, runs, rest);
+            appendValue(payload, uint32_t(runs.size()));
+            for (const BaseRun &run: runs) {
+                appendValue(payload, uint32_t(run.start_));
+                appendValue(payload, uint32_t(run.length_));
+                appendValue(payload, run.base_);
+            }
+            payload.resize((payload.size() + 7) / 8 * 8, '\0');
+            return encodeBases(codec, code_table, coded, payload);
+        }
+        /**
+         * Encodes bases and appends them to a block payload (8-byte aligned so far).
+         *
+         * With the BlockHuffman and ContextHuffman codecs the coded bases start with a byte that tells how they
+         * are coded: 0 with the table of the File, 1 with a table of its own (its code lengths follow), 2 with the
+         * tables of its order-2 contexts (ContextHuffman codec only). The smallest one is taken, so a block only
+         * carries tables when the codes they save pay for them. Then zeros up to a multiple of 8 bytes, and the
+         * codes (mode 2: the ContextHuffman payload).
+         * @param codec How the block is encoded.
+         * @param code_table The Huffman codes.
+         * @param residues The bases.
+         * @param payload [out] The encoded bases are appended.
+         * @return FALSE if a base has no code in the table (see HuffmanCodeTable::encode).
+         */
+        static bool encodeBases(FabinCodec codec, const HuffmanCodeTable &code_table, std::string_view residues,
+                                std::string &payload) {
+            if (codec == FabinCodec::Rans) {
+                BaseHistogram histogram;
+                histogram.count(residues.data(), residues.size());
+                uint64_t frequency[256];
+                for (int c = 0; c < 256; c++) frequency[c] = histogram[c];
+                RansCodec::encode(residues, frequency, payload);
+                return true;
+            }
+            if (codec == FabinCodec::BlockHuffman || codec == FabinCodec::ContextHuffman) {
+                BaseHistogram histogram;
+                histogram.count(residues.data(), residues.size());
+                uint64_t frequency[256];
+                for (int c = 0; c < 256; c++) frequency[c] = histogram[c];
+                HuffmanCodeTable block_table(frequency);
+                std::string own;
+                appendCodeLengths(own, block_table.lengths());
+                uint64_t own_bytes = (own.size() + 1 + 7) / 8 * 8 + (block_table.cost(frequency) + 63) / 64 * 8;
+                uint64_t file_bits = code_table.cost(frequency);
+                uint64_t file_bytes = file_bits == UINT64_MAX ? UINT64_MAX : 8 + (file_bits + 63) / 64 * 8;
+                if (codec == FabinCodec::ContextHuffman) {
+                    std::string context;
+                    ContextHuffman::encode(residues, context);
+                    if (8 + context.size() < std::min(own_bytes, file_bytes)) {
+                        payload.push_back(2);
+                        payload.resize(payload.size() + 7, '\0');
+                        payload.append(context);
+                        return true;
+                    }
+                }
+                bool use_own = own_bytes < file_bytes;
+                payload.push_back(char(use_own));
+                if (use_own) payload.append(own);
+                payload.resize((payload.size() + 7) / 8 * 8, '\0');
+                std::vector<uint64_t> words;
+                BitWriter writer(words);
+                bool encoded = (use_own ? block_table : code_table).encode(residues, writer);
+                writer.flush();
+                payload.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t));
+                return encoded;
+            }
+            if (codec == FabinCodec::TwoBit) {
+                std::vector<uint8_t> packed;
+                std::vector<BaseRun> exceptions, lowercase;
+                TwoBitCodec::pack(residues, packed, exceptions, lowercase);
+                payload.append(reinterpret_cast<const char *>(packed.data()), packed.size());
+                appendValue(payload, uint32_t(exceptions.size()));
+                for (const BaseRun &run: exceptions) {
+                    appendValue(payload, uint32_t(run.start_));
+                    appendValue(payload, uint32_t(run.length_));
+                    appendValue(payload, run.base_);
+                }
+                appendValue(payload, uint32_t(lowercase.size()));
+                for (const BaseRun &run: lowercase) {
+                    appendValue(payload, uint32_t(run.start_));
+                    appendValue(payload, uint32_t(run.length_));
+                }
+                return true;
+            }
+            std::vector<uint64_t> words;
+            BitWriter writer(words);
+            bool encoded = code_table.encode(residues, writer);
+            writer.flush();
+            payload.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t));
+            return encoded;
+        }
+        /**
+         * Cuts the residues of a Sequence in blocks and queues them.
+         * @param sequence The Sequence, its residues must stay alive until finish().
+         */
+        void addSequence(const DNA_sequence::Sequence &sequence) {
+            FabinSequence entry;
+            entry.name_ = sequence.seq_name_;
+            entry.max_length_ = sequence.maxLenLine();
+            entry.crlf_ = true;
+            for (std::string_view line: sequence.linesList()) countLine(entry, line);
+            entry.crlf_ = entry.crlf_ && entry.lines_count_ > 0;
+            std::string_view residues = sequence.residues();
+            countLowercase(entry, 0, residues); //Soft-masked bases loaded from a .fa or a .fabin.
+            entry.residues_ = residues.size();
+            entry.first_block_ = uint32_t(blocks_.size() + pending_.size());
+            for (size_t offset = 0; offset < residues.size(); offset += block_bases_) {
+                entry.blocks_count_++;
+                if (entry.lowercase_runs_.empty()) {
+                    queue(residues.substr(offset, block_bases_));
+                    continue;
+                }
+                std::string block(residues.substr(offset, block_bases_)); //The blocks hold the bases in uppercase.
+                for (char &base: block) base = char(toupper(static_cast<unsigned char>(base)));
+                owned_.push_back(std::move(block));
+                queue(owned_.back());
+            }
+            sequences_.push_back(std::move(entry));
+        }
+        /**
+         * Starts a Sequence that is added line by line.
+         * @param name The name of the Sequence.
+         */
+        void beginSequence(const std::string &name) {
+            in_sequence_ = true;
+            streaming_ = FabinSequence();
+            streaming_.name_ = name;
+            streaming_.crlf_ = true;
+            streaming_.first_block_ = uint32_t(blocks_.size() + pending_.size());
+            current_.clear();
+            current_.reserve(block_bases_);
+        }
+        /**
+         * Adds a DNA Line to the Sequence started by beginSequence (the line is copied).
+         * @param line The DNA Line, in uppercase.
+         * @param original The line as it was read, if it had soft-masked (lowercase) bases.
+         */
+        void addLine(std::string_view line, std::string_view original = std::string_view()) {
+            if (original.data() != nullptr && original.data() != line.data()) {
+                countLowercase(streaming_, streaming_.residues_, original);
+            }
+            countLine(streaming_, line);
+            streaming_.residues_ += line.size();
+            while (!line.empty()) { //A line may cross the end of a block.
+                size_t taken = std::min(line.size(), size_t(block_bases_) - current_.size());
+                current_.append(line.data(), taken);
+                line.remove_prefix(taken);
+                if (current_.size() == block_bases_) queueCurrent();
+            }
+        }
+        /**
+         * Ends the Sequence started by beginSequence.
+         * @param max_length The longest DNA Line (invalid lines count too, like in Sequence::addLine).
+         */
+        void endSequence(int64_t max_length) {
+            if (!current_.empty()) queueCurrent();
+            streaming_.max_length_ = max_length;
+            streaming_.crlf_ = streaming_.crlf_ && streaming_.lines_count_ > 0;
+            sequences_.push_back(std::move(streaming_));
+            streaming_ = FabinSequence();
+            in_sequence_ = false;
+        }
+        /**
+         * Keeps a line of the .fa that is not a DNA Line (a preamble, an invalid line, an empty line, a record
+         * without DNA Lines...) as it was, where it was: after the DNA Lines added so far to the current Sequence,
+         * or to the last one, or before the first one. With them, the .fa is written back byte by byte.
+         * @param line The line, without its line-break.
+         */
+        void addOtherLine(std::string_view line) {
+            if (in_sequence_) {
+                streaming_.other_lines_.push_back({uint64_t(streaming_.lines_count_), std::string(line)});
+            } else if (!sequences_.empty()) {
+                FabinSequence &last = sequences_.back();
+                last.other_lines_.push_back({uint64_t(last.lines_count_), std::string(line)});
+            } else {
+                preamble_.emplace_back(line);
+            }
+        }
+        /**
+         * Tells if the last line of the .fa had a line-break.
+         * @param line_break FALSE if the .fa ended without one.
+         */
+        void setLineBreakAtEnd(bool line_break) {
+            line_break_at_end_ = line_break;
+        }
+        /**
+         * Writes the index and the trailer, and closes the file.
+         * @return FALSE if something could not be written, or a base had no code (the File is not valid).
+         */
+        bool finish() {
+            flush();
+            align();
+            uint64_t index_offset = position_;
+            std::string index;
+            appendValue(index, uint32_t(sequences_.size()));
+            for (const FabinSequence &entry: sequences_) {
+                appendText(index, entry.name_);
+                appendValue(index, entry.max_length_);
+                appendValue(index, entry.lines_count_);
+                appendValue(index, uint64_t(entry.length_runs_.size() / 2));
+                index.append(reinterpret_cast<const char *>(entry.length_runs_.data()),
+                             entry.length_runs_.size() * sizeof(uint64_t));
+                appendValue(index, uint8_t(entry.crlf_));
+                appendValue(index, entry.residues_);
+                appendValue(index, entry.first_block_);
+                appendValue(index, entry.blocks_count_);
+                appendValue(index, uint64_t(entry.lowercase_runs_.size() / 2));
+                index.append(reinterpret_cast<const char *>(entry.lowercase_runs_.data()),
+                             entry.lowercase_runs_.size() * sizeof(uint64_t));
+                appendValue(index, uint64_t(entry.other_lines_.size()));
+                for (const FabinLine &line: entry.other_lines_) {
+                    appendValue(index, line.after_);
+                    appendText(index, line.text_);
+                }
+            }
+            appendValue(index, uint64_t(preamble_.size()));
+            for (const std::string &line: preamble_) appendText(index, line);
+            appendValue(index, uint8_t(line_break_at_end_));
+            appendValue(index, uint32_t(blocks_.size()));
+            for (const FabinBlock &block: blocks_) {
+                appendValue(index, block.offset_);
+                appendValue(index, block.size_);
+                appendValue(index, block.bases_);
+                appendValue(index, block.checksum_);
+            }
+            appendValue(index, index_offset);
+            index.append(kFabinIndexMagic, sizeof(kFabinIndexMagic));
+            write(index.data(), index.size());
+            return output_.close() && encoded_;
+        }
+    };
+
+    /**
+     * Reads a block-structured .fabin File (see FabinWriter).
+     *
+     * The file is memory-mapped and only the header and the index are parsed when it's opened; the blocks are
+     * decoded (and their CRC-32 checked) on demand, so fetching a small region of a big File touches one or two
+     * blocks only.
+     */
+    class FabinReader {
+    private:
+        MappedFile file_; /// The file.
+        bool good_ = false; /// TRUE if the header and the index are valid.
+        FabinCodec codec_ = FabinCodec::Huffman; /// How the blocks are encoded.
+        uint8_t code_lengths_[256] = {}; /// The code lengths of the File (see codecUsesTable).
+        std::unique_ptr<HuffmanDecoder> decoder_; /// Built once (see codecUsesTable).
+        uint32_t block_bases_ = kFabinBlockBases; /// Bytes of residues per block.
+        std::vector<FabinSequence> sequences_; /// The Sequences.
+        std::vector<FabinBlock> blocks_; /// The blocks.
+        std::vector<std::string> preamble_; /// The lines before the first Sequence.
+        bool line_break_at_end_ = true; /// FALSE if the last line of the .fa had no line-break.
+
+        /// Parses the header and the index.
+        bool parse() {
+            if (!file_.good() || file_.size() < sizeof(kFabinMagic) + 2 + 12) return false;
+            ByteCursor header(file_.data(), file_.end());
+            const char *magic = header.take(sizeof(kFabinMagic));
+            if (memcmp(magic, kFabinMagic, sizeof(kFabinMagic)) != 0 || header.read<uint8_t>() != kFabinVersion) {
+                return false;
+            }
+            codec_ = header.read<FabinCodec>();
+            if (codec_ > FabinCodec::Rans) return false;
+            auto symbols = header.read<uint16_t>();
+            for (uint16_t i = 0; i < symbols; i++) {
+                auto byte = header.read<uint8_t>();
+                code_lengths_[byte] = header.read<uint8_t>();
+            }
+            block_bases_ = header.read<uint32_t>();
+            if (!header.ok() || block_bases_ == 0 || !validCodeLengths(code_lengths_)) return false;
+            ByteCursor trailer(file_.end() - 12, file_.end());
+            auto index_offset = trailer.read<uint64_t>();
+            if (memcmp(trailer.take(sizeof(kFabinIndexMagic)), kFabinIndexMagic, sizeof(kFabinIndexMagic)) != 0 ||
+                index_offset > file_.size() - 12) {
+                return false;
+            }
+            ByteCursor index(file_.data() + index_offset, file_.end() - 12);
+            auto sequences_count = index.read<uint32_t>();
+            for (uint32_t i = 0; i < sequences_count && index.ok(); i++) {
+                FabinSequence entry;
+                entry.name_ = index.readText();
+                entry.max_length_ = index.read<int64_t>();
+                entry.lines_count_ = index.read<int64_t>();
+                index.readValues(std::min<uint64_t>(index.read<uint64_t>(), UINT64_MAX / 2) * 2, entry.length_runs_);
+                entry.crlf_ = index.read<uint8_t>() != 0;
+                entry.residues_ = index.read<uint64_t>();
+                entry.first_block_ = index.read<uint32_t>();
+                entry.blocks_count_ = index.read<uint32_t>();
+                index.readValues(std::min<uint64_t>(index.read<uint64_t>(), UINT64_MAX / 2) * 2, entry.lowercase_runs_);
+                auto other_count = index.read<uint64_t>();
+                for (uint64_t line = 0; line < other_count && index.ok(); line++) {
+                    FabinLine other;
+                    other.after_ = index.read<uint64_t>();
+                    other.text_ = index.readText();
+                    if (other.after_ > uint64_t(entry.lines_count_) ||
+                        (!entry.other_lines_.empty() && other.after_ < entry.other_lines_.back().after_)) {
+                        return false;
+                    }
+                    entry.other_lines_.push_back(std::move(other));
+                }
+                sequences_.push_back(std::move(entry));
+            }
+            auto preamble_count = index.read<uint64_t>();
+            for (uint64_t line = 0; line < preamble_count && index.ok(); line++) preamble_.push_back(index.readText());
+            line_break_at_end_ = index.read<uint8_t>() != 0;
+            auto blocks_count = index.read<uint32_t>();
+            for (uint32_t i = 0; i < blocks_count && index.ok(); i++) {
+                FabinBlock block{};
+                block.offset_ = index.read<uint64_t>();
+                block.size_ = index.read<uint64_t>();
+                block.bases_ = index.read<uint32_t>();
+                block.checksum_ = index.read<uint32_t>();
+                if (block.offset_ > index_offset || block.size_ > index_offset - block.offset_) return false;
+                blocks_.push_back(block);
+            }
+            if (!index.ok()) return false;
+            for (const FabinSequence &entry: sequences_) {
+                if (uint64_t(entry.first_block_) + entry.blocks_count_ > blocks_.size()) return false;
+                if (entry.residues_ > uint64_t(entry.blocks_count_) * block_bases_) return false;
+                uint64_t lines = 0, bytes = 0; //Every DNA Line has a run, and at least one byte.
+                for (size_t run = 0; run + 1 < entry.length_runs_.size(); run += 2) {
+                    uint64_t length = entry.length_runs_[run], repeats = entry.length_runs_[run + 1];
+                    if (length == 0 || repeats > (entry.residues_ - bytes) / length) return false;
+                    lines += repeats;
+                    bytes += length * repeats;
+                }
+                if (entry.lines_count_ < 0 || lines != uint64_t(entry.lines_count_)) return false;
+                if (bytes != entry.residues_) return false; //The DNA Lines hold every residue.
+                if (entry.max_length_ < 0) return false;
+            }
+            if (codecUsesTable(codec_)) decoder_ = std::make_unique<HuffmanDecoder>(code_lengths_);
+            return true;
+        }
+
+    public:
+        /**
+         * Opens the file and reads its index.
+         * @param file_name The .fabin file.
+         */
+        explicit FabinReader(const std::string &file_name) : file_(file_name, false) {
+            good_ = parse();
+        }
+        /// TRUE if the file is a valid .fabin.
+        bool good() const {
+            return good_;
+        }
+        /// How the blocks are encoded.
+        FabinCodec codec() const {
+            return codec_;
+        }
+        /// The Sequences of the File.
+        const std::vector<FabinSequence> &sequences() const {
+            return sequences_;
+        }
+        /// The blocks of the File.
+        const std::vector<FabinBlock> &blocks() const {
+            return blocks_;
+        }
+        /**
+         * Decodes a block.
+         * @param block The block.
+         * @param out [out] blocks()[block].bases_ bytes.
+         * @return FALSE if the block is corrupted (bad checksum or payload).
+         */
+        bool decodeBlock(size_t block, char *out) const {
+            const FabinBlock &entry = blocks_[block];
+            const char *payload = file_.data() + entry.offset_;
+            if (crc32(payload, entry.size_) != entry.checksum_) return false;
+            if (codec_ == FabinCodec::TwoBit) {
+                ByteCursor cursor(payload, payload + entry.size_);
+                auto packed = reinterpret_cast<const uint8_t *>(cursor.take((size_t(entry.bases_) + 3) / 4));
+                std::vector<BaseRun> exceptions, lowercase;
+                auto exceptions_count = cursor.read<uint32_t>();
+                for (uint32_t i = 0; i < exceptions_count && cursor.ok(); i++) {
+                    BaseRun run{cursor.read<uint32_t>(), cursor.read<uint32_t>(), 0};
+                    run.base_ = cursor.read<char>();
+                    exceptions.push_back(run);
+                }
+                auto lowercase_count = cursor.read<uint32_t>();
+                for (uint32_t i = 0; i < lowercase_count && cursor.ok(); i++) {
+                    BaseRun run{cursor.read<uint32_t>(), cursor.read<uint32_t>(), 0};
+                    lowercase.push_back(run);
+                }
+                if (!cursor.ok()) return false;
+                TwoBitCodec::unpack(packed, entry.bases_, exceptions, lowercase, out);
+                return true;
+            }
+            ByteCursor cursor(payload, payload + entry.size_); //The long runs (see encodeBlock).
+            auto runs_count = cursor.read<uint32_t>();
+            if (runs_count > entry.size_ / 9) return false;
+            std::vector<BaseRun> runs(runs_count);
+            uint64_t run_bytes = 0;
+            for (size_t i = 0; i < runs.size() && cursor.ok(); i++) {
+                runs[i].start_ = cursor.read<uint32_t>();
+                runs[i].length_ = cursor.read<uint32_t>();
+                runs[i].base_ = cursor.read<char>();
+                run_bytes += runs[i].length_;
+            }
+            if (!cursor.ok() || !RunLength::valid(runs, entry.bases_)) return false;
+            size_t header = (4 + runs.size() * 9 + 7) / 8 * 8; //Up to a multiple of 8.
+            if (header > entry.size_) return false;
+            if (!decodeBases(payload + header, size_t(entry.size_ - header), out + run_bytes,
+                             size_t(entry.bases_ - run_bytes))) {
+                return false;
+            }
+            if (!runs.empty()) RunLength::expand(out, entry.bases_, runs);
+            return true;
+        }
+        /**
+         * Decodes the bases that follow the run table of a block (see encodeBases).
+         * @param payload The coded bases (8-byte aligned).
+         * @param size Bytes of the coded bases.
+         * @param out [out] The bases.
+         * @param count Number of bases.
+         * @return FALSE if the coded bases are not valid.
+         */
+        bool decodeBases(const char *payload, size_t size, char *out, size_t count) const {
+            if (codec_ == FabinCodec::Rans) return RansCodec::decode(payload, size, out, count);
+            const HuffmanDecoder *decoder = decoder_.get();
+            std::unique_ptr<HuffmanDecoder> block_decoder; //The table of the block, if it has one.
+            size_t header = 0;
+            if (codec_ == FabinCodec::BlockHuffman || codec_ == FabinCodec::ContextHuffman) {
+                if (size < 8) return false;
+                if (payload[0] == 2 && codec_ == FabinCodec::ContextHuffman) {
+                    return ContextHuffman::decode(payload + 8, size - 8, out, count);
+                }
+                if (payload[0] > 1) return false;
+                if (payload[0] == 1) {
+                    uint8_t length[256];
+                    const char *codes = readCodeLengths(payload + 1, payload + size, length);
+                    if (codes == nullptr) return false;
+                    block_decoder = std::make_unique<HuffmanDecoder>(length);
+                    decoder = block_decoder.get();
+                    header = size_t(codes - payload);
+                }
+                header = (std::max<size_t>(header, 1) + 7) / 8 * 8;
+                if (header > size) return false;
+            }
+            BitReader reader(reinterpret_cast<const uint64_t *>(payload + header),
+                             (size - header) / sizeof(uint64_t));
+            return decoder->decode(reader, out, count);
+        }
+        /**
+         * Decodes every block of every Sequence, in parallel, each one straight to its place in the output.
+         * @param outputs [out] The residues buffer of every Sequence (sequences()[i].residues_ bytes each).
+         * @param threads Number of threads (0 = defaultThreads()).
+         * @return FALSE if a block is corrupted.
+         */
+        bool decodeAll(const std::vector<char *> &outputs, unsigned threads = 0) const {
+            struct Task {
+                size_t block_; /// The block.
+                const FabinSequence *sequence_; /// Its Sequence.
+                uint64_t offset_; /// Its position in the residues.
+                char *out_; /// Where it goes.
+            };
+            std::vector<Task> tasks;
+            for (size_t sequence = 0; sequence < sequences_.size() && sequence < outputs.size(); sequence++) {
+                const FabinSequence &entry = sequences_[sequence];
+                uint64_t offset = 0;
+                for (uint32_t block = entry.first_block_; block < entry.first_block_ + entry.blocks_count_; block++) {
+                    if (offset + blocks_[block].bases_ > entry.residues_) return false;
+                    tasks.push_back({block, &entry, offset, outputs[sequence] + offset});
+                    offset += blocks_[block].bases_;
+                }
+                if (offset != entry.residues_) return false;
+            }
+            std::atomic<bool> ok{true};
+            parallelFor(tasks.size(), [&](size_t index, unsigned) {
+                const Task &task = tasks[index];
+                if (!decodeBlock(task.block_, task.out_)) ok = false;
+                task.sequence_->applyLowercase(task.offset_, task.out_, blocks_[task.block_].bases_);
+            }, threads);
+            return ok;
+        }
+        /**
+         * Decodes every block of a Sequence.
+         * @param sequence The Sequence (position in sequences()).
+         * @param residues [out] The residues.
+         * @param threads Number of threads (0 = defaultThreads()).
+         * @return FALSE if a block is corrupted.
+         */
+        bool decodeSequence(size_t sequence, std::string &residues, unsigned threads = 0) const {
+            const FabinSequence &entry = sequences_[sequence];
+            residues.resize(size_t(entry.residues_));
+            std::vector<size_t> offsets; //Where every block of the Sequence starts.
+            uint64_t offset = 0;
+            for (uint32_t block = entry.first_block_; block < entry.first_block_ + entry.blocks_count_; block++) {
+                offsets.push_back(size_t(offset));
+                offset += blocks_[block].bases_;
+            }
+            if (offset != residues.size()) return false;
+            std::atomic<bool> ok{true};
+            parallelFor(offsets.size(), [&](size_t index, unsigned) {
+                if (!decodeBlock(entry.first_block_ + index, &residues[offsets[index]])) ok = false;
+                entry.applyLowercase(offsets[index], &residues[offsets[index]], blocks_[entry.first_block_ + index].bases_);
+            }, threads);
+            return ok;
+        }
+        /**
+         * Writes the File back as .fa text, byte by byte as it was read by the stream (the '>' line, the DNA Lines
+         * with their soft-masked bases and the other lines of every Sequence, in their places), decoding a few
+         * blocks at a time in parallel, so memory doesn't depend on the size of the File.
+         * @param out The output (written behind by its own thread while the next blocks are decoded).
+         * @param threads Number of threads (0 = defaultThreads()).
+         * @return FALSE if a block is corrupted or the output fails.
+         */
+        bool writeFasta(OutputPipeline &out, unsigned threads = 0) const {
+            if (threads == 0) threads = defaultThreads();
+            std::vector<std::string> buffers(size_t(threads) * 4); //Decoded blocks of a batch (reused).
+            std::atomic<bool> ok{true};
+            bool line_break = false; //A line-break is owed: the last line only gets it if the .fa had it.
+            auto writeLine = [&](std::string_view line) {
+                if (line_break) out.put('\n');
+                out.write(line.data(), line.size());
+                line_break = true;
+            };
+            for (const std::string &line: preamble_) writeLine(line);
+            for (const FabinSequence &entry: sequences_) {
+                writeLine(">" + entry.name_);
+                size_t run = 0; //Position in the line-length runs.
+                uint64_t repeats_left = 0; //Lines left in the current run.
+                uint64_t line_left = 0; //Bases left in the current line.
+                uint64_t lines_done = 0; //DNA Lines written.
+                size_t other = 0; //Next of the other lines.
+                auto writeOtherLines = [&]() { //The ones that go after the DNA Lines written so far.
+                    while (other < entry.other_lines_.size() && entry.other_lines_[other].after_ == lines_done) {
+                        writeLine(entry.other_lines_[other++].text_);
+                    }
+                };
+                writeOtherLines();
+                uint32_t end_block = entry.first_block_ + entry.blocks_count_;
+                uint64_t offset = 0; //Position of the batch in the residues.
+                for (uint32_t first = entry.first_block_; first < end_block; first += uint32_t(buffers.size())) {
+                    size_t count = std::min<size_t>(buffers.size(), end_block - first);
+                    std::vector<uint64_t> offsets(count);
+                    for (size_t index = 0; index < count; index++) {
+                        offsets[index] = offset;
+                        offset += blocks_[first + index].bases_;
+                    }
+                    parallelFor(count, [&](size_t index, unsigned) {
+                        buffers[index].resize(blocks_[first + index].bases_);
+                        if (!decodeBlock(first + index, &buffers[index][0])) ok = false;
+                        entry.applyLowercase(offsets[index], &buffers[index][0], buffers[index].size());
+                    }, threads);
+                    if (!ok) return false;
+                    for (size_t index = 0; index < count; index++) { //Cut the residues back in DNA Lines.
+                        std::string_view data = buffers[index];
+                        while (!data.empty()) {
+                            if (line_left == 0) {
+                                while (repeats_left == 0 && run + 1 < entry.length_runs_.size()) {
+                                    repeats_left = entry.length_runs_[run + 1];
+                                    run += 2;
+                                }
+                                if (repeats_left == 0) return false; //More residues than DNA Lines.
+                                line_left = entry.length_runs_[run - 2];
+                                repeats_left--;
+                                if (line_break) out.put('\n');
+                                line_break = false;
+                            }
+                            size_t taken = size_t(std::min<uint64_t>(line_left, data.size()));
+                            out.write(data.data(), taken);
+                            data.remove_prefix(taken);
+                            line_left -= taken;
+                            if (line_left == 0) {
+                                line_break = true;
+                                lines_done++;
+                                writeOtherLines();
+                            }
+                        }
+                    }
+                }
+                if (line_left != 0) return false;
+                for (; other < entry.other_lines_.size(); other++) writeLine(entry.other_lines_[other].text_);
+            }
+            if (line_break && line_break_at_end_) out.put('\n');
+            return out.good();
+        }
+        /**
+         * Finds a Sequence by name: the whole name, or its first word.
+         * @return The position in sequences(), or -1.
+         */
+        long findSequence(const std::string &name) const {
+            for (size_t i = 0; i < sequences_.size(); i++) {
+                const std::string &full = sequences_[i].name_;
+                if (full == name || full.substr(0, full.find_first_of(" \t\r")) == name) return long(i);
+            }
+            return -1;
+        }
+        /**
+         * Fetches a region, decoding only the blocks that overlap it.
+         * @param region "name", "name:start" or "name:start-end" (1-based, inclusive, ',' allowed in numbers).
+         * @param bases [out] The bases of the region (without '\r').
+         * @return FALSE if the Sequence doesn't exist, the region is empty or a block is corrupted.
+         */
+        bool fetch(const std::string &region, std::string &bases) const {
+            bases.clear();
+            Region query = parseRegion(region);
+            long sequence = findSequence(query.name_);
+            if (sequence < 0 && query.name_ != region) { //The name may contain a ':'.
+                query = parseRegion(region, true);
+                sequence = findSequence(query.name_);
+            }
+            if (sequence < 0) return false;
+            const FabinSequence &entry = sequences_[size_t(sequence)];
+            uint64_t start = query.start_, end = std::min(query.end_, entry.basesCount());
+            if (start < 1 || start > end) return false;
+            uint64_t first = entry.residuesOffset(start - 1), last = entry.residuesOffset(end); //[first, last)
+            std::string block_bases;
+            for (uint64_t block = first / block_bases_; block * block_bases_ < last; block++) {
+                size_t index = entry.first_block_ + size_t(block);
+                if (block >= entry.blocks_count_) return false;
+                block_bases.resize(blocks_[index].bases_);
+                if (!decodeBlock(index, &block_bases[0])) return false;
+                uint64_t block_start = block * block_bases_;
+                entry.applyLowercase(block_start, &block_bases[0], block_bases.size());
+                uint64_t from = std::max(first, block_start) - block_start;
+                uint64_t to = std::min<uint64_t>(last - block_start, block_bases.size());
+                for (uint64_t i = from; i < to; i++) {
+                    if (block_bases[i] != '\r') bases.push_back(block_bases[i]);
+                }
+            }
+            return true;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_FABINCONTAINER_H
@@ -0,0 +1,234 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_FAIINDEX_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_FAIINDEX_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "IoPipeline.h"
+#include "MappedFile.h"
+#include "Region.h"
+
+namespace FastaFile {
+    /// A line of a .fai index (samtools faidx format).
+    struct FaiEntry {
+        std::string name_; /// First word of the '>' line.
+        uint64_t length_ = 0; /// Number of bases.
+        uint64_t offset_ = 0; /// Position in the file of the first base.
+        uint64_t line_bases_ = 0; /// Bases per line.
+        uint64_t line_bytes_ = 0; /// Bytes per line, line-break included.
+    };
+
+    /**
+     * The .fai index of a .fa File: where every Sequence starts and how it's wrapped, so any base can be found
+     * with a little arithmetic. Every line of a Sequence but the last one must have the same length.
+     */
+    class FaiIndex {
+    private:
+        std::vector<FaiEntry> entries_; /// In File order.
+        std::unordered_map<std::string, size_t> by_name_; /// Position of every name in entries_.
+
+        /// Adds an entry.
+        void add(FaiEntry entry) {
+            by_name_.emplace(entry.name_, entries_.size());
+            entries_.push_back(std::move(entry));
+        }
+
+    public:
+        /**
+         * Scans a .fa File (once, memory-mapped) and indexes every Sequence.
+         * @param fa_file The .fa File.
+         * @return FALSE if the File can't be read or a Sequence has lines of different lengths (it's reported).
+         */
+        bool build(const std::string &fa_file) {
+            entries_.clear();
+            by_name_.clear();
+            MappedFile input(fa_file);
+            if (!input.good()) return false;
+            const char *cursor = input.data(), *file_end = input.end();
+            FaiEntry entry;
+            bool in_sequence = false, short_seen = false;
+            while (cursor < file_end) {
+                auto line_end = static_cast<const char *>(memchr(cursor, '\n', size_t(file_end - cursor)));
+                if (line_end == nullptr) line_end = file_end; //The last line may not have a line-break.
+                auto size = size_t(line_end - cursor);
+                if (size > 0 && *cursor == '>') {
+                    if (in_sequence) add(entry);
+                    const char *name_end = cursor + 1;
+                    while (name_end < line_end && !isspace(static_cast<unsigned char>(*name_end))) name_end++;
+                    entry = FaiEntry();
+                    entry.name_.assign(cursor + 1, name_end);
+                    entry.offset_ = uint64_t(line_end - input.data()) + 1;
+                    in_sequence = true;
+                    short_seen = false;
+                } else if (in_sequence) {
+                    uint64_t bases = size > 0 && cursor[size - 1] == '\r' ? size - 1 : size;
+                    if (entry.line_bytes_ == 0 && bases > 0) { //The first line gives the wrapping.
+                        entry.line_bases_ = bases;
+                        entry.line_bytes_ = size + 1;
+                    } else if (bases > 0 && (short_seen || size + 1 > entry.line_bytes_)) {
+                        std::cout << "The Sequence " << entry.name_
+                                  << " has lines of different lengths, it can't be indexed... please check. "
+                                  << std::endl;
+                        return false;
+                    } else if (size + 1 < entry.line_bytes_) {
+                        short_seen = true;
+                    }
+                    entry.length_ += bases;
+                }
+                cursor = line_end + 1;
+            }
+            if (in_sequence) add(entry);
+            return true;
+        }
+        /**
+         * Reads a .fai File.
+         * @param fai_file The .fai File.
+         * @return FALSE if it can't be read or a line is not valid.
+         */
+        bool load(const std::string &fai_file) {
+            entries_.clear();
+            by_name_.clear();
+            std::ifstream input(fai_file);
+            if (!input.is_open()) return false;
+            std::string line;
+            while (std::getline(input, line)) {
+                if (line.empty()) continue;
+                FaiEntry entry;
+                size_t tab = line.find('\t');
+                if (tab == std::string::npos) return false;
+                entry.name_ = line.substr(0, tab);
+                uint64_t *fields[] = {&entry.length_, &entry.offset_, &entry.line_bases_, &entry.line_bytes_};
+                const char *position = line.c_str() + tab;
+                for (uint64_t *field: fields) {
+                    if (*position != '\t') return false;
+                    char *number_end;
+                    *field = std::strtoull(position + 1, &number_end, 10);
+                    if (number_end == position + 1) return false;
+                    position = number_end;
+                }
+                add(entry);
+            }
+            return true;
+        }
+        /**
+         * Writes the index as a .fai File.
+         * @param fai_file The .fai File.
+         * @return FALSE if it can't be written.
+         */
+        bool save(const std::string &fai_file) const {
+            OutputPipeline output(fai_file);
+            for (const FaiEntry &entry: entries_) {
+                std::string line = entry.name_ + "\t" + std::to_string(entry.length_) + "\t" +
+                                   std::to_string(entry.offset_) + "\t" + std::to_string(entry.line_bases_) + "\t" +
+                                   std::to_string(entry.line_bytes_) + "\n";
+                output.write(line.data(), line.size());
+            }
+            return output.close();
+        }
+        /// The Sequences.
+        const std::vector<FaiEntry> &entries() const {
+            return entries_;
+        }
+        /**
+         * Finds a Sequence by name (the first word of its '>' line).
+         * @return The position in entries(), or -1.
+         */
+        long find(const std::string &name) const {
+            auto found = by_name_.find(name);
+            return found == by_name_.end() ? -1 : long(found->second);
+        }
+    };
+
+    /**
+     * A .fa File opened through its .fai index: the File is memory-mapped for random access and only the bases
+     * that are asked for are ever read, so a few contigs of a big reference cost a few page faults.
+     *
+     * The index is read from file_name + ".fai", or built and saved there if it's missing or older than the File.
+     */
+    class IndexedFasta {
+    private:
+        MappedFile file_; /// The .fa File.
+        FaiIndex index_; /// Its index.
+        bool good_ = false; /// TRUE if the File and the index are ready.
+
+        /// TRUE if the .fai exists and is not older than the .fa.
+        static bool indexFresh(const std::string &fa_file, const std::string &fai_file) {
+#ifdef FASTA_HAS_MMAP
+            struct stat fa_info{}, fai_info{};
+            if (::stat(fai_file.c_str(), &fai_info) != 0 || ::stat(fa_file.c_str(), &fa_info) != 0) return false;
+            return fai_info.st_mtime >= fa_info.st_mtime;
+#else
+            return std::ifstream(fai_file).good();
+#endif
+        }
+
+    public:
+        /**
+         * Opens the File and its index.
+         * @param fa_file The .fa File.
+         */
+        explicit IndexedFasta(const std::string &fa_file) : file_(fa_file, false) {
+            if (!file_.good()) return;
+            std::string fai_file = fa_file + ".fai";
+            if (indexFresh(fa_file, fai_file) && index_.load(fai_file)) {
+                good_ = true;
+                return;
+            }
+            if (!index_.build(fa_file)) return;
+            if (!index_.save(fai_file)) {
+                std::cout << "The File " << fai_file << " could not be written... please check. " << std::endl;
+            }
+            good_ = true;
+        }
+        /// TRUE if the File and the index are ready.
+        bool good() const {
+            return good_;
+        }
+        /// The index.
+        const FaiIndex &index() const {
+            return index_;
+        }
+        /**
+         * Fetches a region, reading only its lines.
+         * @param region "name", "name:start" or "name:start-end" (1-based, inclusive, ',' allowed in numbers).
+         * @param bases [out] The bases of the region (without line-breaks).
+         * @return FALSE if the Sequence doesn't exist, the region is empty or the index doesn't match the File.
+         */
+        bool fetch(const std::string &region, std::string &bases) const {
+            bases.clear();
+            Region query = parseRegion(region);
+            long sequence = index_.find(query.name_);
+            if (sequence < 0 && query.name_ != region) { //The name may contain a ':'.
+                query = parseRegion(region, true);
+                sequence = index_.find(query.name_);
+            }
+            if (sequence < 0) return false;
+            const FaiEntry &entry = index_.entries()[size_t(sequence)];
+            uint64_t start = query.start_, end = std::min(query.end_, entry.length_);
+            if (start < 1 || start > end || entry.line_bases_ == 0) return false;
+            bases.reserve(size_t(end - start + 1));
+            for (uint64_t base = start - 1; base < end;) { //One piece per line.
+                uint64_t column = base % entry.line_bases_;
+                uint64_t position = entry.offset_ + base / entry.line_bases_ * entry.line_bytes_ + column;
+                uint64_t taken = std::min(entry.line_bases_ - column, end - base);
+                if (position + taken > file_.size()) return false;
+                bases.append(file_.data() + position, size_t(taken));
+                base += taken;
+            }
+            return true;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_FAIINDEX_H
@@ -9,72 +9,223 @@ namespace FastaFile {
 
     FASTAFile::FASTAFile() = default; //default constructor.
 
-    FASTAFile::FASTAFile(std::string &file_name) // Constructor when using a .Fa File as parameter.
+    FASTAFile::FASTAFile(const FASTAFile &obj) { //Copy Builder, the copy gets its own arena.
+        *this = obj;
+    }
+
+    FASTAFile &FASTAFile::operator=(FASTAFile const &obj) {
+        if (this == &obj) return *this;
+        this->arena_ = std::make_shared<DNA_sequence::SequenceArena>();
+        this->sequences_list_.clear();
+        for (const auto &sequence: obj.sequences_list_) { //Deep copy of the residues, one block per Sequence.
+            this->sequences_list_.emplace_back(sequence, this->arena_);
+        }
+        this->alphabet_ = obj.alphabet_;
+        this->mapa_freq_ = obj.mapa_freq_;
+        this->mapa_ = obj.mapa_;
+        this->search_index_ = obj.search_index_; //Immutable, can be shared until one of the Files is masked.
+        this->searches_count_ = obj.searches_count_;
+        this->lazy_ = obj.lazy_; //The cache only holds what was read from the File, it can be shared.
+        this->file_name_ = obj.file_name_;
+        this->empty_file_ = false;
+        this->file_bases_count = obj.file_bases_count;
+        this->DNAsequences_count = obj.DNAsequences_count;
+        return *this;
+    }
+
+    FASTAFile::FASTAFile(std::string &file_name, DNA_sequence::AlphabetKind alphabet) // Constructor when using a .Fa File as parameter.
     {
+        this->alphabet_ = &DNA_sequence::BaseAlphabet::get(alphabet);
         file_name = prepareFileName(file_name, ".fa"); //Preparing and saving the file name.
         std::cout << "Preparing to build the Fasta File ... Please Wait. " << std::endl;
         std::cout << this->file_name_ << std::endl;
-        std::ifstream basicIfstream(file_name); //Open the file
-        bool last = false;
-        bool check_pass = basicIfstream.good(); // Basic bool to check if the file is good.
-        if (check_pass) {
-            std::string lineIN_string; //Prepare a String obj to stream the input from the file.
-            this->DNAsequences_count = 0; // Initialize DNAsequences_count.
-            std::list<DNA_sequence::Sequence> list_of_Sequences; //Prepare a list to save every instance of Sequences found.
-            std::list<std::string> list_of_sequences_lines; //Prepare a list to save every DNA line from each sequence.
-            while (getline(basicIfstream, lineIN_string)) {
-                last = false;
-                char check_secuencia = lineIN_string[0]; //The first char of the line indicates if it's a new Sequence or not.
-                if (check_secuencia == '>') {
-                    bool empty_sequence = true; //We do not know if the sequence will be ok or not.
-                    DNA_sequence::Sequence sequence_INobj(lineIN_string.substr(1), this->valids_); //Prepare a new Sequence Object to load information.
-                    std::string reading_string_line; //New String Obj to read every DNA line.
-                    int position = int(basicIfstream.tellg()); //Saving position from first potential DNA line.
-                    while (getline(basicIfstream, reading_string_line)) {
-                        check_secuencia = reading_string_line[0]; //get first char of the potential DNA line.
-                        if (check_secuencia != '>' &&
-                            check_secuencia != '\0') { //check if it's not another sequence and not the end.
-                            if (sequence_INobj.addLine(reading_string_line)) {
-                                empty_sequence = false; //
-                                position = int(basicIfstream.tellg());
-                            }//Try to add the line, if success the sequence is no longer empty and save next safe position.
-                        } else { // If the line is not a potential DNA line...
-                            if (sequence_INobj.sequenceCorrect() &&
-                                !empty_sequence) { //Evaluates if the Sequence is correct, and has at least one sequence.
-                                list_of_Sequences.push_back(sequence_INobj); //Add the Sequence to the list.
-                                this->DNAsequences_count += 1; // ... +1 Sequence.
-                                last = true; //if pass the If condition, then we will be in the last line of the Sequence.
-                            } else { //If the Sequence is not correctly loaded... destroy it.
-                                sequence_INobj.clear();
-                            }
-                            basicIfstream.seekg(position); //if it's not a DNA line, returns to the last safe position.
-                            break; //Stop the While loop, try another Sequence.
-                        }
-                    }
-                    if (position == -1 ||
-                        !last) { //if the safe position is also the last pos of the file ... It's because of the while loop condition.
-                        if (sequence_INobj.sequenceCorrect() &&
-                            !empty_sequence) { //try to save the last sequence loaded.
-                            list_of_Sequences.push_back(sequence_INobj);
-                            this->DNAsequences_count += 1;
-                        }
-                    }
-                }
-            } //End of the File Reading...
-            if (this->DNAsequences_count > 0) { //If we successfully loaded at least a Sequence...
-                this->sequences_list_ = list_of_Sequences; //Assign the list of Sequences loaded.
-                this->empty_file_ = false; //File is not Empty.
-            }
-        } else { //If we can't open the file ...
+        auto start_time = std::chrono::steady_clock::now();
+        MappedFile input_file(file_name); //Map the whole file, it's scanned only once.
+        if (!input_file.good()) { //If we can't open the file ...
             std::cout << "File not found... please check. " << std::endl;
             file_name_.clear();
             return; // Stop the function if it's no file.
         }
+        this->DNAsequences_count = 0; // Initialize DNAsequences_count.
+        const char *file_begin = input_file.data();
+        const char *file_end = input_file.end();
+        size_t chunks_count = std::max<size_t>(1, std::min<size_t>(size_t(defaultThreads()) * 4,
+                                                                   input_file.size() / kParseChunkMin));
+        std::vector<const char *> bounds{file_begin}; //Chunk i is [bounds[i], bounds[i + 1]).
+        for (size_t chunk = 1; chunk < chunks_count; chunk++) { //Every cut is moved to the next '>' line.
+            const char *cut = file_begin + input_file.size() / chunks_count * chunk;
+            cut = std::max(cut, bounds.back());
+            while (cut < file_end) {
+                cut = static_cast<const char *>(memchr(cut, '>', size_t(file_end - cut)));
+                if (cut == nullptr) cut = file_end;
+                else if (cut[-1] == '\n') break;
+                else cut++;
+            }
+            bounds.push_back(std::min(cut, file_end));
+        }
+        bounds.push_back(file_end);
+        std::vector<std::list<DNA_sequence::Sequence>> parts(chunks_count); //The Sequences of every chunk.
+        parallelFor(chunks_count, [&](size_t chunk, unsigned) { //Own arena per chunk, arenas are not shared.
+            auto arena = chunk == 0 ? this->arena_ : std::make_shared<DNA_sequence::SequenceArena>();
+            parseRecords(bounds[chunk], bounds[chunk + 1], *this->alphabet_, arena, parts[chunk]);
+        });
+        for (auto &part: parts) { //File order.
+            this->DNAsequences_count += int(part.size());
+            this->sequences_list_.splice(this->sequences_list_.end(), part);
+        }
+        if (this->DNAsequences_count > 0) this->empty_file_ = false; //File is not Empty.
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
 
         this->HuffmanEncodder(false);
 
         std::cout << "File " << this->file_name_ << " has been read, " << this->DNAsequences_count
                   << " Sequences found successfully" << std::endl;
+        if (timingsSetting()) {
+            std::cout << "Parsed " << input_file.size() << " bytes in " << elapsed.count() << " s ("
+                      << (elapsed.count() > 0 ? double(input_file.size()) / elapsed.count() / 1e9 : 0.0)
+                      << " GB/s)" << std::endl;
+        }
+    }
+
+    FASTAFile::FASTAFile(std::string &file_name, DNA_sequence::AlphabetKind alphabet, size_t resident_limit) {
+        this->alphabet_ = &DNA_sequence::BaseAlphabet::get(alphabet);
+        file_name = prepareFileName(file_name, ".fa");
+        auto start_time = std::chrono::steady_clock::now();
+        auto lazy = std::make_shared<LazySequences>(file_name, *this->alphabet_, resident_limit);
+        if (!lazy->good()) {
+            std::cout << "File not found... please check. " << std::endl;
+            file_name_.clear();
+            return;
+        }
+        this->lazy_ = lazy;
+        this->DNAsequences_count = int(lazy->size());
+        this->empty_file_ = lazy->size() == 0;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        std::cout << "File " << this->file_name_ << " opened, " << this->DNAsequences_count
+                  << " Sequences found (parsed on demand, " << resident_limit << " in memory at most)" << std::endl;
+        if (timingsSetting()) {
+            std::cout << "Scanned " << lazy->fileSize() << " bytes in " << elapsed.count() << " s" << std::endl;
+        }
+    }
+
+    bool FASTAFile::isLazy() const {
+        return this->lazy_ != nullptr;
+    }
+
+    void FASTAFile::materialize() {
+        if (!this->lazy_) return;
+        std::shared_ptr<LazySequences> lazy = std::move(this->lazy_);
+        this->sequences_list_.clear();
+        this->DNAsequences_count = 0;
+        for (size_t i = 0; i < lazy->size(); i++) {
+            std::shared_ptr<DNA_sequence::Sequence> cached = lazy->get(i); //It may still be handed out, copy it.
+            if (cached->identation() == 0) continue; //No valid line, the loader drops it too.
+            this->sequences_list_.emplace_back(*cached, this->arena_);
+            this->DNAsequences_count++;
+        }
+        this->empty_file_ = this->DNAsequences_count == 0;
+        this->HuffmanEncodder(false);
+    }
+
+    std::shared_ptr<DNA_sequence::Sequence> FASTAFile::sequence(const std::string &name) {
+        if (this->lazy_) {
+            long index = this->lazy_->find(name);
+            return index < 0 ? nullptr : this->lazy_->get(size_t(index));
+        }
+        for (auto &sequence: this->sequences_list_) {
+            const std::string &full = sequence.seq_name_;
+            if (full == name || full.substr(0, full.find_first_of(" \t\r")) == name) {
+                return std::shared_ptr<DNA_sequence::Sequence>(std::shared_ptr<void>(), &sequence); //Not owned.
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<SearchMatch> FASTAFile::findSubSequence(const std::string &sub_sequence,
+                                                        const std::string &sequence_name) {
+        std::vector<SearchMatch> matches;
+        std::shared_ptr<DNA_sequence::Sequence> found = this->sequence(sequence_name);
+        if (!found) return matches;
+        size_t sequence_index = 0; //Position of the Sequence in the File.
+        if (this->lazy_) {
+            sequence_index = size_t(this->lazy_->find(sequence_name));
+        } else {
+            for (const auto &sequence: this->sequences_list_) {
+                if (&sequence == found.get()) break;
+                sequence_index++;
+            }
+        }
+        HorspoolSearcher searcher(sub_sequence);
+        SearchText text(*found); //Every base of the Sequence, so matches can span line-breaks.
+        searcher.findAll(text.text(), [&](size_t offset) {
+            matches.push_back({sequence_index, offset});
+        });
+        return matches;
+    }
+
+    void FASTAFile::parseRecords(const char *cursor, const char *file_end, const DNA_sequence::BaseAlphabet &alphabet,
+                                 const std::shared_ptr<DNA_sequence::SequenceArena> &arena,
+                                 std::list<DNA_sequence::Sequence> &list_of_Sequences) {
+        while (cursor < file_end) {
+            if (*cursor != '>') { //Not a Sequence header, jump straight to the next '>' that starts a line.
+                const char *next_header = cursor;
+                do {
+                    next_header = static_cast<const char *>(memchr(next_header, '>', file_end - next_header));
+                    if (next_header == nullptr) break;
+                    if (next_header[-1] == '\n') break;
+                    ++next_header;
+                } while (next_header < file_end);
+                if (next_header == nullptr || next_header >= file_end) break; //No more Sequences.
+                cursor = next_header;
+            }
+            const char *line_end = nextLineEnd(cursor, file_end);
+            const char *record_end = nextHeader(line_end, cursor, file_end);
+            DNA_sequence::Sequence &sequence = list_of_Sequences.emplace_back(std::string(cursor + 1, line_end),
+                                                                              alphabet, arena); //A new Sequence.
+            if (line_end < file_end) { //Its bases fit in the record, so its buffer is allocated once.
+                sequence.reserveResidues(size_t((record_end == nullptr ? file_end : record_end) - line_end - 1));
+            }
+            bool has_lines; //Read every DNA line until the next header, an empty line or the end.
+            cursor = readDnaLines(line_end + 1, file_end, sequence, has_lines);
+            sequence.releaseSpareResidues();
+            if (!sequence.sequenceCorrect() || !has_lines) { //Correct, and at least one line?
+                list_of_Sequences.pop_back();
+            }
+        }
+    }
+
+    const char *FASTAFile::nextLineEnd(const char *line_begin, const char *file_end) {
+        auto line_end = static_cast<const char *>(memchr(line_begin, '\n', file_end - line_begin));
+        return line_end == nullptr ? file_end : line_end; //The last line may not have a line-break.
+    }
+
+    FASTAFile::FASTAFile(FASTAFile &&obj) noexcept //Move Builder, the members are moved (no default arena_).
+            : sequences_list_(std::move(obj.sequences_list_)), arena_(std::move(obj.arena_)),
+              DNAsequences_count(obj.DNAsequences_count), file_name_(std::move(obj.file_name_)),
+              empty_file_(obj.empty_file_), alphabet_(obj.alphabet_), file_bases_count(obj.file_bases_count),
+              mapa_(std::move(obj.mapa_)), mapa_freq_(std::move(obj.mapa_freq_)),
+              search_index_(std::move(obj.search_index_)), searches_count_(obj.searches_count_),
+              lazy_(std::move(obj.lazy_)) {
+        obj.DNAsequences_count = 0;
+        obj.empty_file_ = true;
+        obj.file_bases_count = 0;
+    }
+
+    FASTAFile &FASTAFile::operator=(FASTAFile &&obj) noexcept {
+        if (this == &obj) return *this;
+        this->sequences_list_ = std::move(obj.sequences_list_);
+        this->arena_ = std::move(obj.arena_);
+        this->DNAsequences_count = std::exchange(obj.DNAsequences_count, 0);
+        this->file_name_ = std::move(obj.file_name_);
+        this->empty_file_ = std::exchange(obj.empty_file_, true);
+        this->alphabet_ = obj.alphabet_;
+        this->file_bases_count = std::exchange(obj.file_bases_count, 0);
+        this->mapa_ = std::move(obj.mapa_);
+        this->mapa_freq_ = std::move(obj.mapa_freq_);
+        this->search_index_ = std::move(obj.search_index_);
+        this->searches_count_ = std::exchange(obj.searches_count_, 0);
+        this->lazy_ = std::move(obj.lazy_);
+        return *this;
     }
 
     std::string FASTAFile::fileName() { //Simple Get Function.
@@ -87,6 +238,14 @@ namespace FastaFile {
     }
 
     void FASTAFile::printInformation() { //Simple information Printer.
+        if (this->lazy_) { //Only what the '>' scan knows, nothing is parsed for it.
+            std::cout << "File: " << file_name_ << " (lazy)" << std::endl;
+            std::cout << "N Sequences in the File:  " << DNAsequences_count << std::endl;
+            std::cout << "Sequences in memory: " << lazy_->resident() << " (parsed so far: " << lazy_->loads() << ")"
+                      << std::endl;
+            for (size_t i = 0; i < lazy_->size(); i++) std::cout << "Sequence: " << lazy_->name(i) << std::endl;
+            return;
+        }
         std::cout << "File: " << file_name_ << std::endl;
         std::cout << "N Sequences loaded in the File:  " << DNAsequences_count << std::endl;
         std::cout << "N different bases contained: " << file_bases_count << std::endl;
@@ -111,76 +270,261 @@ namespace FastaFile {
 
     void FASTAFile::exportLegible() { //Human readable .fa file export.
         if (this->empty_file_) std::cout << "The File is Empty!" << std::endl;
-        std::ofstream file_obj; //basic file_obj ofstream.
         std::string export_file_name = this->file_name_ + "_export_FA.fa"; // Prepare new export file_name.
-        file_obj.open(export_file_name, std::ofstream::out); // Open the File, not append.
-        std::list<DNA_sequence::Sequence>::iterator it; // Iterator of the list of Sequences.
-        it = this->sequences_list_.begin(); //Initialize the iterator.
-        std::list<std::string>::iterator its; //String Iterator (on list)
-        for (; it != this->sequences_list_.end(); ++it) { //for loop in the list of sequences.
-            file_obj << ">"; //Add the identifier.
-            file_obj << it->seqName(); //Add the name of the Sequence.
-            file_obj << std::endl; //Line-break.
-            std::list<std::string> line_string_list; //list of the lines of the Sequence.
-            line_string_list = it->linesList();
-            for (its = line_string_list.begin();
-                 its != line_string_list.end(); ++its) { //Add every string (line) of the Sequence.
-                file_obj << *its;
-                file_obj << std::endl;
+        if (this->exportFasta(export_file_name)) std::cout << "Successfully export! " << export_file_name << std::endl;
+    }
+
+    bool FASTAFile::exportFasta(const std::string &export_file_name, size_t line_width, bool write_fai) {
+        this->materialize(); //The whole File is needed.
+        OutputPipeline file_obj(export_file_name); // Big buffers written by their own thread, no flush per line.
+        std::string fai; //One line per Sequence: name, bases, offset, bases per line, bytes per line.
+        bool indexable = true;
+        for (const auto &sequence: this->sequences_list_) {
+            file_obj.put('>'); //Add the identifier.
+            file_obj.write(sequence.seq_name_.data(), sequence.seq_name_.size()); //Add the name of the Sequence.
+            file_obj.put('\n'); //Line-break.
+            uint64_t offset = file_obj.position(), bases = 0;
+            size_t line_bases = 0, line_bytes = 0;
+            if (line_width == 0) { //Every string (line) of the Sequence as it is, no copies.
+                bool first = true, short_seen = false; //Only the last line may be shorter.
+                for (std::string_view line: sequence.linesList()) {
+                    size_t cr = !line.empty() && line.back() == '\r' ? 1 : 0; //faidx counts it in the line-break.
+                    if (first) {
+                        line_bases = line.size() - cr;
+                        line_bytes = line.size() + 1;
+                        first = false;
+                    } else if (short_seen || line.size() + 1 > line_bytes) {
+                        indexable = false;
+                    }
+                    short_seen = short_seen || line.size() + 1 < line_bytes;
+                    bases += line.size() - cr;
+                    file_obj.write(line.data(), line.size());
+                    file_obj.put('\n');
+                }
+            } else { //Re-wrap: the residues flow across the original lines (the '\r' that end them are dropped).
+                size_t column = 0;
+                for (std::string_view line: sequence.linesList()) {
+                    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                    bases += line.size();
+                    while (!line.empty()) {
+                        size_t taken = std::min(line.size(), line_width - column);
+                        file_obj.write(line.data(), taken);
+                        line.remove_prefix(taken);
+                        column += taken;
+                        if (column == line_width) {
+                            file_obj.put('\n');
+                            column = 0;
+                        }
+                    }
+                }
+                if (column > 0) file_obj.put('\n');
+                line_bases = line_width;
+                line_bytes = line_width + 1;
             }
+            fai += sequence.seq_name_.substr(0, sequence.seq_name_.find_first_of(" \t\r")) + "\t" +
+                   std::to_string(bases) + "\t" + std::to_string(offset) + "\t" + std::to_string(line_bases) +
+                   "\t" + std::to_string(line_bytes) + "\n";
+        }
+        if (!file_obj.close()) {
+            std::cout << "The File " << export_file_name << " could not be written... please check. " << std::endl;
+            return false;
+        }
+        if (!write_fai) return true;
+        if (!indexable) {
+            std::cout << "The DNA Lines have different lengths, re-wrap the File to index it... please check. "
+                      << std::endl;
+            return true;
         }
-        file_obj.close();
-        std::cout << "Successfully export! " << export_file_name << std::endl;
+        OutputPipeline fai_file(export_file_name + ".fai");
+        fai_file.write(fai.data(), fai.size());
+        if (!fai_file.close()) {
+            std::cout << "The File " << export_file_name << ".fai could not be written... please check. " << std::endl;
+            return false;
+        }
+        return true;
     }
 
-
     int FASTAFile::isSubSequence(std::string sub_sequence) {
         if (this->empty_file_) {
             return 0;
         }
-        int contador = 0;
-        typename std::list<DNA_sequence::Sequence>::iterator it;
-        it = this->sequences_list_.begin();
-        std::list<std::string>::iterator its;
-        for (; it != this->sequences_list_.end(); ++it) {
-            std::list<std::string> lista_string;
-            lista_string = it->linesList();
-            for (its = lista_string.begin(); its != lista_string.end(); ++its) {
-                int N = int(its->length());
-                int M = int(sub_sequence.length());
-                for (int i = 0; i <= N - M; i++) {
-                    int j;
-                    for (j = 0; j < M; j++) {
-                        std::string check = *its;
-                        if (check[i + j] != sub_sequence[j]) break;
-                    }
-                    if (j == M) {
-                        contador++;
-                    }
-                }
+        return int(findSubSequence(sub_sequence).size());
+    }
+
+    std::vector<SearchMatch> FASTAFile::findSubSequence(const std::string &sub_sequence) {
+        this->materialize(); //The whole File is needed.
+        if (!this->search_index_ && ++this->searches_count_ == kSearchesBeforeIndex) this->buildSearchIndex();
+        if (this->search_index_) return this->search_index_->find(sub_sequence); //O(M + occ) with the index.
+        std::vector<SearchMatch> matches;
+        HorspoolSearcher searcher(sub_sequence); //Compiled once for every Sequence.
+        size_t sequence_index = 0;
+        for (const auto &sequence: this->sequences_list_) {
+            SearchText text(sequence); //Every base of the Sequence, so matches can span line-breaks.
+            searcher.findAll(text.text(), [&](size_t offset) {
+                matches.push_back({sequence_index, offset});
+            });
+            sequence_index++;
+        }
+        return matches;
+    }
+
+    bool FASTAFile::buildSearchIndex() {
+        this->materialize(); //The whole File is needed.
+        if (this->search_index_) return true;
+        auto index = std::make_shared<FMIndex>();
+        if (!index->build(this->sequences_list_)) {
+            std::cout << "The File is too big for the search index, using the sequential search." << std::endl;
+            return false;
+        }
+        std::cout << "Search index built (" << index->memoryBytes() / 1024 << " KB)." << std::endl;
+        this->search_index_ = index;
+        return true;
+    }
+
+    std::vector<PatternHits> FASTAFile::batchSearch(const std::vector<std::string> &patterns, bool reverse_complement) {
+        this->materialize(); //The whole File is needed.
+        std::vector<PatternHits> results;
+        std::vector<std::string> searched; //Every pattern of the automaton, results[i] <-> searched[i].
+        for (const auto &pattern: patterns) {
+            results.push_back({pattern, pattern, false, {}});
+            searched.push_back(pattern);
+            std::string reversed = reverseComplement(pattern);
+            if (reverse_complement && reversed != pattern) { //Palindromes would be counted twice.
+                results.push_back({pattern, reversed, true, {}});
+                searched.push_back(reversed);
             }
         }
-        return contador;
+        AhoCorasick automaton(searched);
+        std::vector<const DNA_sequence::Sequence *> sequences;
+        for (const auto &sequence: this->sequences_list_) sequences.push_back(&sequence);
+        std::vector<std::vector<std::pair<size_t, size_t>>> found(sequences.size()); //(pattern, offset) per Sequence.
+        parallelFor(sequences.size(), [&](size_t index, unsigned) {
+            SearchText text(*sequences[index]);
+            automaton.scan(text.text(), [&](size_t pattern, size_t offset) {
+                found[index].emplace_back(pattern, offset);
+            });
+        });
+        for (size_t index = 0; index < found.size(); index++) { //Merge in File order.
+            std::sort(found[index].begin(), found[index].end());
+            for (auto &hit: found[index]) results[hit.first].matches_.push_back({index, hit.second});
+        }
+        return results;
+    }
+
+    std::vector<PatternHits> FASTAFile::batchSearch(const std::string &patterns_file, bool reverse_complement) {
+        std::ifstream input(patterns_file);
+        if (!input.good()) {
+            std::cout << "File not found... please check. " << std::endl;
+            return {};
+        }
+        std::vector<std::string> patterns;
+        std::vector<std::string> names;
+        std::string line, name;
+        while (getline(input, line)) {
+            while (!line.empty() && isspace(static_cast<unsigned char>(line.back()))) line.pop_back();
+            if (line.empty()) continue;
+            if (line[0] == '>') { //The name of the next pattern.
+                name = line.substr(1);
+                continue;
+            }
+            patterns.push_back(line);
+            names.push_back(name.empty() ? line : name);
+            name.clear();
+        }
+        std::vector<PatternHits> results = batchSearch(patterns, reverse_complement);
+        size_t pattern = 0;
+        for (auto &hits: results) { //The reverse complement comes right after its pattern.
+            if (hits.reverse_) pattern--;
+            hits.name_ = names[pattern++];
+        }
+        return results;
     }
 
     void FASTAFile::maskFile(const std::string &to_mask) {
         maskFile(to_mask, "X"); //Mask (replace) every Base (o combination) to "X" default Base.
     }
 
-    void FASTAFile::maskFile(const std::string &to_mask, const std::string &mask) { //Implementation.
-        typename std::list<DNA_sequence::Sequence>::iterator it;
-        std::list<std::string>::iterator its;
-        for (it = this->sequences_list_.begin();
-             it != this->sequences_list_.end(); ++it) { //For every Sequence in the file.
-            std::list<std::string> lista_string;
-            lista_string = it->linesList();
-            for (its = lista_string.begin(); its != lista_string.end(); ++its) { //For every Line in the Sequence.
-                std::string aux;
-                aux = (std::regex_replace(*its, std::regex(to_mask), mask)); //uses the std::regex_replace.
-                *its = aux;
+    void FASTAFile::maskFile(const std::string &to_mask, const std::string &mask, bool iupac) { //Implementation.
+        this->materialize(); //The whole File is needed.
+        this->search_index_.reset(); //The bases will change, the search index is no longer valid.
+        this->searches_count_ = 0;
+        if (to_mask.empty()) return;
+        MaskPattern pattern(to_mask, iupac); //Compiled once for the whole File.
+        bool skip_cr = to_mask.find('\r') == std::string::npos; //Matches span the '\r' of CRLF lines.
+        std::vector<DNA_sequence::Sequence *> sequences;
+        for (auto &sequence: this->sequences_list_) sequences.push_back(&sequence);
+        if (mask.size() == 1 || mask.size() == to_mask.size()) { //Same length, masked in place (and in parallel).
+            parallelFor(sequences.size(), [&](size_t index, unsigned) {
+                DNA_sequence::Sequence &sequence = *sequences[index];
+                ResidueMap map(sequence.residues(), skip_cr);
+                std::vector<size_t> starts;
+                pattern.findAll(sequence.residues(), map, [&](size_t start) { starts.push_back(start); });
+                char *residues = sequence.mutableResidues();
+                size_t last_end = 0; //End of the last replaced match.
+                for (size_t start: starts) { //Every base of every match, also across line-breaks.
+                    if (start < last_end) continue; //Overlaps the last replaced match.
+                    last_end = start + pattern.length();
+                    for (size_t i = 0; i < pattern.length(); i++) {
+                        residues[map[start + i]] = mask.size() == 1 ? mask[0] : mask[i];
+                    }
+                }
+            });
+            return;
+        }
+        std::string residues; //The new bases of a Sequence, reused by every Sequence.
+        std::vector<size_t> line_lengths;
+        for (auto sequence: sequences) { //Different length, every line is rebuilt (the arena is not shared by threads).
+            residues.clear();
+            line_lengths.clear();
+            for (std::string_view line: sequence->linesList()) { //For every Line in the Sequence.
+                ResidueMap map(line, skip_cr);
+                size_t line_begin = residues.size();
+                size_t copied = 0; //Bases of the line already in residues.
+                pattern.findAll(line, map, [&](size_t start) {
+                    if (map[start] < copied) return; //Overlaps the last replaced match.
+                    residues.append(line.substr(copied, map[start] - copied));
+                    residues.append(mask);
+                    copied = map[start + pattern.length() - 1] + 1;
+                });
+                residues.append(line.substr(copied));
+                line_lengths.push_back(residues.size() - line_begin);
             }
-            it->updateSeqLinesList(lista_string); //Update all the Sequences lines.
+            sequence->assignLines(residues, line_lengths); //Update all the Sequences lines, a single block.
+        }
+    }
+
+    size_t FASTAFile::maskIntervals(const std::string &bed_file, bool soft, char mask) {
+        this->materialize(); //The whole File is needed.
+        std::vector<MaskInterval> intervals;
+        if (!readBedFile(bed_file, intervals)) {
+            std::cout << "File not found... please check. " << std::endl;
+            return 0;
         }
+        this->search_index_.reset();
+        this->searches_count_ = 0;
+        std::map<std::string, std::vector<MaskInterval>> by_sequence; //Intervals grouped by Sequence.
+        for (auto &interval: intervals) by_sequence[interval.sequence_].push_back(interval);
+        std::vector<DNA_sequence::Sequence *> sequences;
+        for (auto &sequence: this->sequences_list_) sequences.push_back(&sequence);
+        std::vector<size_t> masked(sequences.size(), 0);
+        parallelFor(sequences.size(), [&](size_t index, unsigned) {
+            DNA_sequence::Sequence &sequence = *sequences[index];
+            std::string name = sequence.seq_name_.substr(0, sequence.seq_name_.find_first_of(" \t\r"));
+            auto found = by_sequence.find(name); //BED files use the first word of the header.
+            if (found == by_sequence.end()) return;
+            ResidueMap map(sequence.residues());
+            char *residues = sequence.mutableResidues();
+            for (auto &interval: found->second) {
+                for (size_t base = interval.start_; base < interval.end_ && base < map.size(); base++) {
+                    char &target = residues[map[base]];
+                    target = soft ? char(tolower(static_cast<unsigned char>(target))) : mask;
+                    masked[index]++;
+                }
+            }
+        });
+        size_t total = 0;
+        for (size_t count: masked) total += count;
+        return total;
     }
 
     void FASTAFile::HuffmanEncodder() {
@@ -189,29 +533,9 @@ namespace FastaFile {
 
     void FASTAFile::HuffmanEncodder(bool Mask) {
         std::map<char, int> freq_map = this->freqMapping();
-        typename std::list<DNA_sequence::Sequence>::iterator it;
-        std::list<std::string>::iterator its;
-        int sizes = int(freq_map.size() + 1);
-        char char_array[sizes - 1];
-        int freq_array[sizes - 1];
-        for (it = this->sequences_list_.begin();
-             it != this->sequences_list_.end(); ++it) {
-            std::list<std::string> lista_string;
-            lista_string = it->linesList();
-            for (its = lista_string.begin(); its != lista_string.end(); ++its) {
-                std::string aux;
-                auto iter = freq_map.begin();
-                while (iter != freq_map.end()) {
-                    for (int i = 0; i < (sizes - 1); i++, iter++) {
-                        char_array[i] = iter->first;
-                        freq_array[i] = iter->second;
-                    }
-                }
-            }
-        }
-        Huffman huff;
-        huff.huffmanEncoder(char_array, freq_array, int(sizeof(char_array) / sizeof(char_array[0])));
-        std::map<char, std::vector<int>> HuffmanOutMap = huff.getFreqMap();
+        uint64_t frequency[256] = {};
+        for (auto &entry: freq_map) frequency[static_cast<unsigned char>(entry.first)] = uint64_t(std::max(entry.second, 1));
+        std::map<char, std::vector<int>> HuffmanOutMap = HuffmanCodeTable(frequency).codification(); //Canonical.
         this->mapa_ = HuffmanOutMap;
         if (Mask) {
             auto iterHuff = HuffmanOutMap.begin();
@@ -221,7 +545,7 @@ namespace FastaFile {
                 std::string mascara_imput = result.str();
                 std::string enmasca_imput(1, iterHuff->first);
                 std::cout << mascara_imput << " : " << enmasca_imput << std::endl;
-                this->maskFile(enmasca_imput, mascara_imput);
+                this->maskFile(enmasca_imput, mascara_imput); //Literal, 'N' is not a wildcard here.
                 ++iterHuff;
             }
             this->mapa_ = HuffmanOutMap;
@@ -229,199 +553,339 @@ namespace FastaFile {
     }
 
     std::map<char, int> FASTAFile::freqMapping() {
+        this->materialize(); //The whole File is needed.
         this->file_bases_count = 0;
         std::map<char, int> map_out;
-        int freq_counter;
-        std::list<char>::iterator it;
-        for (it = this->valids_.begin(); it != this->valids_.end(); ++it) {
-            std::string entrada(1, *it);
-            freq_counter = isSubSequence(entrada);
-            if (freq_counter > 0) {
+        BaseHistogram histogram = BaseHistogram::ofSequences(this->sequences_list_); //One pass over every residue.
+        for (int c = 0; c < 256; c++) { //Every symbol present gets an entry (only valid bases are stored).
+            if (histogram[c] > 0) {
                 this->file_bases_count++;
-                map_out.emplace(*it, freq_counter);
+                map_out.emplace(char(c), int(histogram[c]));
             }
         }
         this->mapa_freq_ = map_out;
         return map_out;
     }
 
-    void FASTAFile::compressFile(std::string file_name) {
+    void FASTAFile::compressFile(std::string file_name, FabinCodec codec, unsigned threads) {
+        this->materialize(); //The whole File is needed.
+        std::string loaded_name = this->file_name_; //prepareFileName renames the File, keep the loaded name.
         file_name = prepareFileName(file_name, ".fabin");
-        std::ofstream outputBIN(file_name, std::ios::out | std::ios::binary);
-        auto bases_int_ = int16_t(this->file_bases_count);
-        outputBIN.write(reinterpret_cast<const char *>(&bases_int_), sizeof(bases_int_));
-        std::map<char, int> freq_map = this->mapa_freq_;
-        std::map<int, int> freq_map_ASCII;
-        auto iter1 = freq_map.begin();
-        while (iter1 != freq_map.end()) {
-            freq_map_ASCII.emplace(int(iter1->first), iter1->second);
-            iter1++;
-        }
-        auto iter2 = freq_map_ASCII.begin();
-        while (iter2 != freq_map_ASCII.end()) {
-            auto ascii_code = int8_t(iter2->first);
-            int64_t frec_code = iter2->second;
-            outputBIN.write(reinterpret_cast<const char *>(&ascii_code), sizeof(ascii_code));
-            outputBIN.write(reinterpret_cast<const char *>(&frec_code), sizeof(frec_code));
-            iter2++;
-        }
-        int32_t sequences_count = this->DNAsequences_count;
-        outputBIN.write(reinterpret_cast<const char *>(&sequences_count), sizeof(sequences_count));
-        auto listiterator = this->sequences_list_.begin();
-        for (; listiterator != this->sequences_list_.end(); ++listiterator) {
-            std::string nombre_temp = listiterator->seqName();
-            int longitud_nombre = int(nombre_temp.length());
-            auto longitud_nombre_ = int16_t(longitud_nombre);
-            outputBIN.write(reinterpret_cast<const char *>(&longitud_nombre_), sizeof(longitud_nombre_));
-            for (char char_nombre: nombre_temp) {
-                outputBIN.write(reinterpret_cast<const char *>(&char_nombre), sizeof(char_nombre));
-            }
-            int64_t longitud_ = listiterator->maxLenLine();
-            auto identation_ = int16_t(listiterator->identation());
-            outputBIN.write(reinterpret_cast<const char *>(&longitud_), sizeof(longitud_));
-            outputBIN.write(reinterpret_cast<const char *>(&identation_), sizeof(identation_));
-            std::list<std::string> lista_i = listiterator->linesList();
-            auto secuenciait = lista_i.begin();
-            for (; secuenciait != lista_i.end(); secuenciait++) {
-                int16_t contador_ = 0;
-                int16_t ceros_ = 0;
-                std::string linea_in = *secuenciait;
-                int N = int(linea_in.size());
-                int j = 0;
-                std::vector<std::string> result;
-                std::string res;
-                while (j < N) {
-                    res += linea_in[j];
-                    if (res.size() == 63) {
-                        result.push_back(res);
-                        contador_++;
-                        res = "";
-                    }
-                    j++;
-                }
-                if (!res.empty()) {
-                    while (res.size() < 63) {
-                        res += "0";
-                        ceros_++;
-                    }
-                    result.push_back(res);
-                    contador_++;
-                }
-                outputBIN.write(reinterpret_cast<const char *>(&contador_), sizeof(contador_));
-                outputBIN.write(reinterpret_cast<const char *>(&ceros_), sizeof(ceros_));
-                for (auto i_: result) {
-                    i_.insert(0, "1");
-                    std::bitset<sizeof(unsigned long) * 8> bits(i_);
-                    unsigned long binary_value = bits.to_ulong();
-                    outputBIN.write(reinterpret_cast<const char *>(&binary_value), sizeof(unsigned long));
-                }
-            }
+        this->file_name_ = loaded_name;
+        this->HuffmanEncodder(false); //Frequencies and codes of the current bases (the File may be masked).
+        HuffmanCodeTable code_table = fabinCodeTable(codec); //Flat (code, length) per byte.
+        FabinWriter writer(file_name, codec, code_table, threads); //Blocks are encoded by the thread pool.
+        for (const auto &sequence: this->sequences_list_) { //Straight from the residues, nothing is modified.
+            writer.addSequence(sequence);
+        }
+        if (!writer.finish()) {
+            std::cout << "The File " << file_name << " could not be written (or a base has no code)... please check. "
+                      << std::endl;
         }
-        outputBIN.close();
     }
 
 
     FASTAFile::FASTAFile(std::string &file_name, const int &bin_opcion) {
         file_name = prepareFileName(file_name, ".fabin");
-        std::ifstream infile(file_name, std::ios::in | std::ios::binary);
-        int16_t bases_count = 0;
-        infile.read((char *) &bases_count, sizeof(bases_count));
-        this->file_bases_count = bases_count;
-        std::map<int, int> freq_map;
-        for (int i = 1; i <= bases_count; i++) {
-            int8_t ascii_code_in = 0;
-            int64_t code_freq_in = 0;
-            infile.read((char *) &ascii_code_in, sizeof(ascii_code_in));
-            infile.read((char *) &code_freq_in, sizeof(code_freq_in));
-            freq_map.emplace(int(ascii_code_in), int(code_freq_in));
-        }
-        auto iter_map = freq_map.begin();
-        int size_map = int(freq_map.size());
-        char char_array[size_map];
-        int freq_array[size_map];
-        while (iter_map != freq_map.end()) {
-            for (int i = 0; i < (size_map); i++, iter_map++) {
-                char_array[i] = char(iter_map->first);
-                freq_array[i] = iter_map->second;
+        FabinReader reader(file_name); //Only the header and the index are read here.
+        if (!reader.good()) {
+            std::cout << "Not a valid .fabin file (or an unsupported version)... please check. " << std::endl;
+            file_name_.clear();
+            return;
+        }
+        auto decode_start = std::chrono::steady_clock::now();
+        size_t decoded_bases = 0;
+        this->DNAsequences_count = int(reader.sequences().size());
+        std::vector<char *> outputs; //The residues buffer of every Sequence, filled by the decoder.
+        for (const FabinSequence &entry: reader.sequences()) {
+            this->sequences_list_.emplace_back(entry.name_, *this->alphabet_, this->arena_);
+            DNA_sequence::Sequence &sequence_obj_in = this->sequences_list_.back();
+            outputs.push_back(sequence_obj_in.allocateLines(size_t(entry.residues_), entry.lineLengths()));
+            sequence_obj_in.updateMaxLenLine(entry.max_length_);
+            decoded_bases += size_t(entry.residues_);
+            empty_file_ = false;
+        }
+        if (!reader.decodeAll(outputs)) { //Every block in parallel.
+            std::cout << "The File " << file_name << " has corrupted blocks... please check. " << std::endl;
+        }
+        std::chrono::duration<double> decode_time = std::chrono::steady_clock::now() - decode_start;
+        if (timingsSetting()) {
+            std::cout << "Decoded " << decoded_bases << " bases in " << decode_time.count() << " s ("
+                      << (decode_time.count() > 0 ? double(decoded_bases) / decode_time.count() / 1e9 : 0.0)
+                      << " GB/s)" << std::endl;
+        }
+        this->HuffmanEncodder(false);
+
+    }
+
+    void FASTAFile::benchmarkScaling(FabinCodec codec) {
+        this->materialize(); //The whole File is needed.
+        std::string bench_file = this->file_name_ + "_BENCH.fabin";
+        this->HuffmanEncodder(false);
+        HuffmanCodeTable code_table = fabinCodeTable(codec);
+        size_t total_bases = 0;
+        for (const auto &sequence: this->sequences_list_) total_bases += sequence.residues().size();
+        std::vector<std::vector<char>> buffers; //Decoded residues, allocated once.
+        std::vector<char *> outputs;
+        std::vector<unsigned> threads_list;
+        unsigned max_threads = std::max(hardwareThreads(), defaultThreads());
+        for (unsigned threads = 1; threads < max_threads; threads *= 2) threads_list.push_back(threads);
+        threads_list.push_back(max_threads);
+        std::cout << "Threads | Compress GB/s | Decompress GB/s | Speed-up (c/d)" << std::endl;
+        double base_compress = 0, base_decompress = 0;
+        for (unsigned threads: threads_list) {
+            auto start = std::chrono::steady_clock::now();
+            FabinWriter writer(bench_file, codec, code_table, threads);
+            for (const auto &sequence: this->sequences_list_) writer.addSequence(sequence);
+            writer.finish();
+            auto compressed = std::chrono::steady_clock::now();
+            FabinReader reader(bench_file);
+            if (buffers.empty()) {
+                for (const FabinSequence &entry: reader.sequences()) {
+                    buffers.emplace_back(size_t(entry.residues_));
+                    outputs.push_back(buffers.back().data());
+                }
             }
+            auto opened = std::chrono::steady_clock::now();
+            reader.decodeAll(outputs, threads);
+            auto decompressed = std::chrono::steady_clock::now();
+            double compress_time = std::chrono::duration<double>(compressed - start).count();
+            double decompress_time = std::chrono::duration<double>(decompressed - opened).count();
+            if (threads == 1) {
+                base_compress = compress_time;
+                base_decompress = decompress_time;
+            }
+            std::cout << threads << " | " << double(total_bases) / compress_time / 1e9 << " | "
+                      << double(total_bases) / decompress_time / 1e9 << " | " << base_compress / compress_time
+                      << "x / " << base_decompress / decompress_time << "x" << std::endl;
+        }
+        std::remove(bench_file.c_str());
+    }
+
+    void FASTAFile::benchmarkAllocations(std::string file_name) {
+        if (!allocationsCounted()) {
+            std::cout << "This program doesn't count its allocations (build it with -DFASTA_COUNT_ALLOCATIONS)... "
+                         "please check. "
+                      << std::endl;
+            return;
+        }
+        AllocationCount before = allocationCount();
+        FASTAFile loaded(file_name);
+        AllocationCount after_load = allocationCount();
+        if (loaded.file_name_.empty()) return;
+        size_t residues = 0, lines = 0;
+        for (const auto &sequence: loaded.sequences_list_) {
+            residues += sequence.residues().size();
+            lines += size_t(sequence.identation());
         }
-        Huffman huff_2;
-        huff_2.huffmanEncoder(char_array, freq_array, int(sizeof(char_array) / sizeof(char_array[0])));
-        int32_t seq_count = 0;
-        infile.read((char *) &seq_count, sizeof(seq_count));
-        std::list<DNA_sequence::Sequence> list_secuencias_in;
-        typename std::list<DNA_sequence::Sequence>::iterator it_ls;
-        this->DNAsequences_count = seq_count;
-        for (int j = 1; j <= seq_count; j++) {
-            DNA_sequence::Sequence sequence_obj_in;
-            std::string seq_name_in;
-            int16_t size_name_in = 0;
-            infile.read((char *) &size_name_in, sizeof(size_name_in));
-            for (int k = 1; k <= size_name_in; k++) {
-                char char_in;
-                infile.read((char *) &char_in, sizeof(char_in));
-                seq_name_in.push_back(char_in);
+        std::list<FASTAFile> files;
+        files.push_back(std::move(loaded));
+        AllocationCount after_move = allocationCount();
+        FASTAFile copied(files.back());
+        AllocationCount after_copy = allocationCount();
+        uint64_t load_allocations = after_load.allocations_ - before.allocations_;
+        std::cout << "Sequences: " << files.back().DNAsequences_count << ", DNA Lines: " << lines << ", bases: "
+                  << residues << " (" << files.back().arena_->chunksCount() << " arena chunks)" << std::endl;
+        std::cout << "Step | Allocations | Bytes" << std::endl;
+        std::cout << "Load | " << load_allocations << " | " << after_load.bytes_ - before.bytes_ << std::endl;
+        std::cout << "Move into a list | " << after_move.allocations_ - after_load.allocations_ << " | "
+                  << after_move.bytes_ - after_load.bytes_ << std::endl;
+        std::cout << "Copy (to compare) | " << after_copy.allocations_ - after_move.allocations_ << " | "
+                  << after_copy.bytes_ - after_move.bytes_ << std::endl;
+        if (files.back().DNAsequences_count > 0) {
+            std::cout << "Load allocations per Sequence: "
+                      << double(load_allocations) / files.back().DNAsequences_count << std::endl;
+        }
+    }
+
+    bool FASTAFile::fetchRegion(std::string file_name, const std::string &region, std::string &bases) {
+        if (hasFastaExtension(file_name)) { //Plain text, through the .fai.
+            IndexedFasta indexed(file_name);
+            if (!indexed.good()) {
+                std::cout << "File not found (or it can't be indexed)... please check. " << std::endl;
+                return false;
             }
-            sequence_obj_in.assignName(seq_name_in);
-            int64_t size_lines_seq;
-            infile.read((char *) &size_lines_seq, sizeof(size_lines_seq));
-            int16_t identation_lines;
-            infile.read((char *) &identation_lines, sizeof(identation_lines));
-            std::list<std::string> lista_filas;
-            for (int x = 1; x <= identation_lines; x++) {
-                std::string final_line_in;
-                int16_t lines_packs = 0;
-                int16_t zeros_count = 0;
-                infile.read((char *) &lines_packs, sizeof(lines_packs));
-                infile.read((char *) &zeros_count, sizeof(zeros_count));
-                for (int i_ = 1; i_ <= lines_packs; i_++) {
-                    unsigned long bin_value;
-                    infile.read((char *) &bin_value, sizeof(bin_value));
-                    std::string binary_line = std::bitset<sizeof(unsigned long) * 8>(bin_value).to_string();
-                    binary_line = binary_line.substr(1, binary_line.size());
-                    final_line_in += binary_line;
-                }
-                final_line_in = final_line_in.substr(0, final_line_in.size() - zeros_count);
-                std::map<char, std::vector<int>> HuffmanOutMap = huff_2.getFreqMap();
-                auto iterHuff = HuffmanOutMap.begin();
-                std::string fin_aux = final_line_in;
-                std::string fin_real;
-                std::map<std::string, char> map_reversed;
-                for (auto &it_: HuffmanOutMap) {
-                    std::vector<int> vect_temp;
-                    vect_temp = it_.second;
-                    auto it_vec = vect_temp.begin();
-                    std::string new_trace;
-                    while (it_vec != vect_temp.end()) {
-                        new_trace += std::to_string(*it_vec);
-                        ++it_vec;
+            return indexed.fetch(region, bases);
+        }
+        if (file_name.size() < 6 || file_name.substr(file_name.size() - 6) != ".fabin") file_name += ".fabin";
+        FabinReader reader(file_name);
+        if (!reader.good()) {
+            std::cout << "Not a valid .fabin file (or an unsupported version)... please check. " << std::endl;
+            return false;
+        }
+        return reader.fetch(region, bases);
+    }
+
+    HuffmanCodeTable FASTAFile::codeTableOf(const BaseHistogram &histogram,
+                                            const DNA_sequence::BaseAlphabet *every_valid) {
+        uint64_t frequency[256] = {}; //Full 64-bit counts, the lengths are computed without a tree.
+        for (int c = 0; c < 256; c++) {
+            bool forced = every_valid != nullptr && every_valid->valid(char(c));
+            frequency[c] = histogram[c] > 0 ? histogram[c] : (forced ? 1 : 0);
+        }
+        return HuffmanCodeTable(frequency);
+    }
+
+    HuffmanCodeTable FASTAFile::fabinCodeTable(FabinCodec codec) const {
+        if (!codecUsesTable(codec)) return HuffmanCodeTable(this->mapa_); //Not stored.
+        BaseHistogram histogram = BaseHistogram::ofSequences(this->sequences_list_, 0, true); //The long runs are not coded.
+        histogram.foldCase();
+        return codeTableOf(histogram);
+    }
+
+    bool FASTAFile::compressStream(std::string fa_file, std::string fabin_file, FabinCodec codec, bool sampled,
+                                   DNA_sequence::AlphabetKind alphabet, unsigned threads) {
+        if (!hasFastaExtension(fa_file)) fa_file += ".fa";
+        if (fabin_file.size() < 6 || fabin_file.substr(fabin_file.size() - 6) != ".fabin") fabin_file += ".fabin";
+        const DNA_sequence::BaseAlphabet &bases = DNA_sequence::BaseAlphabet::get(alphabet);
+        auto start_time = std::chrono::steady_clock::now();
+        HuffmanCodeTable code_table{std::map<char, std::vector<int>>()};
+        if (codecUsesTable(codec)) { //First pass (or a sample): the frequencies.
+            struct {
+                BaseHistogram histogram_;
+                std::string buffer_; //Lines are counted in big chunks.
+                uint64_t limit_ = UINT64_MAX, seen_ = 0;
+                void header(const std::string &) {}
+                bool line(std::string_view line, std::string_view) {
+                    buffer_.append(line);
+                    seen_ += line.size();
+                    if (buffer_.size() >= (size_t(1) << 20)) {
+                        histogram_.countWithoutRuns(buffer_.data(), buffer_.size());
+                        buffer_.clear();
                     }
-                    map_reversed[new_trace] = it_.first;
+                    return seen_ < limit_;
                 }
-                while (!fin_aux.empty()) {
-                    std::string check_str;
-                    bool b = false;
-                    while (!b) {
-                        check_str += fin_aux.substr(0, 1);
-                        fin_aux = fin_aux.substr(1, fin_aux.size());
-                        if (map_reversed.count(check_str)) {
-                            fin_real.push_back(map_reversed[check_str]);
-                            b = true;
-                            check_str = "";
-                        }
-                    }
+                void end(size_t, size_t) {}
+                void other(std::string_view) {}
+                void finish(bool) {}
+            } counter;
+            if (sampled) counter.limit_ = kSampleBytes;
+            if (streamFasta(fa_file, bases, counter) < 0) {
+                std::cout << "File not found... please check. " << std::endl;
+                return false;
+            }
+            counter.histogram_.countWithoutRuns(counter.buffer_.data(), counter.buffer_.size());
+            code_table = codeTableOf(counter.histogram_, sampled ? &bases : nullptr);
+        }
+        FabinWriter writer(fabin_file, codec, code_table, threads);
+        if (!writer.good()) {
+            std::cout << "The File " << fabin_file << " could not be written... please check. " << std::endl;
+            return false;
+        }
+        struct {
+            FabinWriter *writer_ = nullptr;
+            std::string name_;
+            bool in_record_ = false; //Between a '>' line and the end of its record.
+            bool started_ = false; //A Sequence is written from its first valid line only.
+            std::vector<std::string> held_; //Other lines of the record before its first valid line.
+            size_t sequences_ = 0;
+            uint64_t residues_ = 0;
+            void header(const std::string &name) {
+                name_ = name;
+                in_record_ = true;
+                started_ = false;
+            }
+            bool line(std::string_view line, std::string_view original) {
+                if (!started_) {
+                    writer_->beginSequence(name_);
+                    for (const std::string &held: held_) writer_->addOtherLine(held);
+                    held_.clear();
                 }
-                final_line_in = fin_real;
-                lista_filas.push_back(final_line_in);
+                started_ = true;
+                writer_->addLine(line, original);
+                residues_ += line.size();
+                return true;
             }
-            sequence_obj_in.updateSeqLinesList(lista_filas);
-            sequence_obj_in.updateMaxLenLine(int(size_lines_seq));
-            list_secuencias_in.push_back(sequence_obj_in);
-            empty_file_ = false;
+            void end(size_t max_length, size_t) {
+                in_record_ = false;
+                if (!started_) { //No valid line, the loader drops it too: its lines are kept as they were.
+                    writer_->addOtherLine(">" + name_);
+                    for (const std::string &held: held_) writer_->addOtherLine(held);
+                    held_.clear();
+                    return;
+                }
+                writer_->endSequence(int64_t(max_length));
+                sequences_++;
+                started_ = false;
+            }
+            void other(std::string_view line) {
+                if (in_record_ && !started_) {
+                    held_.emplace_back(line);
+                } else {
+                    writer_->addOtherLine(line);
+                }
+            }
+            void finish(bool line_break) {
+                writer_->setLineBreakAtEnd(line_break);
+            }
+        } encoder;
+        encoder.writer_ = &writer;
+        int64_t bytes = streamFasta(fa_file, bases, encoder);
+        if (bytes < 0) {
+            std::cout << "File not found... please check. " << std::endl;
+            return false;
         }
-        sequences_list_ = list_secuencias_in;
-        this->HuffmanEncodder(false);
+        if (!writer.finish()) {
+            std::cout << "The File " << fabin_file << " could not be written (or a base has no code)... please check. "
+                      << std::endl;
+            return false;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        std::cout << "Compressed " << encoder.sequences_ << " Sequences (" << encoder.residues_ << " bases) to "
+                  << fabin_file;
+        if (timingsSetting()) {
+            std::cout << " in " << elapsed.count() << " s ("
+                      << (elapsed.count() > 0 ? double(bytes) / elapsed.count() / 1e9 : 0.0) << " GB/s)";
+        }
+        std::cout << std::endl;
+        return true;
+    }
+
+    bool FASTAFile::decompressStream(std::string fabin_file, std::string fa_file, unsigned threads) {
+        if (fabin_file.size() < 6 || fabin_file.substr(fabin_file.size() - 6) != ".fabin") fabin_file += ".fabin";
+        if (!hasFastaExtension(fa_file)) fa_file += ".fa";
+        FabinReader reader(fabin_file);
+        if (!reader.good()) {
+            std::cout << "Not a valid .fabin file (or an unsupported version)... please check. " << std::endl;
+            return false;
+        }
+        auto start_time = std::chrono::steady_clock::now();
+        OutputPipeline output(fa_file);
+        if (!reader.writeFasta(output, threads) || !output.close()) {
+            std::cout << "The File " << fabin_file << " has corrupted blocks (or " << fa_file
+                      << " could not be written)... please check. " << std::endl;
+            return false;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        uint64_t residues = 0;
+        for (const FabinSequence &entry: reader.sequences()) residues += entry.residues_;
+        std::cout << "Decompressed " << reader.sequences().size() << " Sequences (" << residues << " bases) to "
+                  << fa_file;
+        if (timingsSetting()) {
+            std::cout << " in " << elapsed.count() << " s ("
+                      << (elapsed.count() > 0 ? double(residues) / elapsed.count() / 1e9 : 0.0) << " GB/s)";
+        }
+        std::cout << std::endl;
+        return true;
+    }
+
+    long FASTAFile::buildFaiIndex(std::string file_name) {
+        if (!hasFastaExtension(file_name)) file_name += ".fa";
+        FaiIndex index;
+        if (!index.build(file_name)) {
+            std::cout << "File not found (or it can't be indexed)... please check. " << std::endl;
+            return -1;
+        }
+        if (!index.save(file_name + ".fai")) {
+            std::cout << "The File " << file_name << ".fai could not be written... please check. " << std::endl;
+            return -1;
+        }
+        return long(index.entries().size());
+    }
 
+    bool FASTAFile::hasFastaExtension(const std::string &file_name) {
+        std::string extension = file_name.substr(std::min(file_name.size(), file_name.rfind('.')));
+        return extension == ".fa" || extension == ".fasta" || extension == ".fna";
     }
 
     std::string FASTAFile::prepareFileName(std::string &file_name, const std::string &extension) {
@@ -443,6 +907,7 @@ namespace FastaFile {
     }
 
     const std::list<DNA_sequence::Sequence> &FASTAFile::getSequencesList()  {
+        this->materialize(); //The whole File is needed.
         return sequences_list_;
     }
 
@@ -8,20 +8,77 @@
 
 #include "Sequence.h"
 #include "Huffman.h"
+#include "Histogram.h"
+#include "SequenceSearch.h"
+#include "AhoCorasick.h"
+#include "MaskEngine.h"
+#include "MappedFile.h"
+#include "FabinContainer.h"
+#include "FastaStream.h"
+#include "FaiIndex.h"
+#include "LazySequences.h"
+#include "AllocationCounter.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 namespace FastaFile {
+    /// The --timings setting: TRUE to print how fast every .fa or .fabin File loads (benchmark output, off by default).
+    inline std::atomic<bool> &timingsSetting() {
+        static std::atomic<bool> setting{false};
+        return setting;
+    }
 
     class FASTAFile {
     private:
         std::list<DNA_sequence::Sequence> sequences_list_;/// List of all sequences into a single File.
+        std::shared_ptr<DNA_sequence::SequenceArena> arena_ = std::make_shared<DNA_sequence::SequenceArena>(); /// Residues of every Sequence, freed in one shot.
         int DNAsequences_count{}; /// N sequences.
         std::string file_name_; /// The .fa name.
         bool empty_file_ = true; /// To check if there's any Sequence
-        std::list<char> valids_ = {'A', 'C', 'G', 'T', 'U', 'R', 'Y', 'K', 'M', 'S', 'W', 'B', 'D', 'H', 'V', 'N',
-                                        'X', '-', '\r'}; /// The default list of valid bases.
+        const DNA_sequence::BaseAlphabet *alphabet_ = &DNA_sequence::BaseAlphabet::get(
+                DNA_sequence::AlphabetKind::Default); /// The valid bases (A, C, G, T, U, R, Y, K, M, S, W, B, D, H, V, N, X, -, \r by default).
         int file_bases_count = 0; /// N_bases of total valids_ bases.
         std::map<char, std::vector<int>> mapa_; // Huffman Results
         std::map<char, int> mapa_freq_; // Frequency Table.
+        std::shared_ptr<const FMIndex> search_index_; /// Optional persistent search index (see buildSearchIndex).
+        int searches_count_ = 0; /// Searches without the index, it is built after kSearchesBeforeIndex of them.
+        static constexpr int kSearchesBeforeIndex = 3; /// One-off queries don't pay for the index.
+        std::shared_ptr<LazySequences> lazy_; /// Lazy mode: the Sequences are parsed on demand (see materialize).
+        /**
+         * Finds the end of the line that starts at line_begin.
+         * @param line_begin First char of the line.
+         * @param file_end One past the last char of the buffer.
+         * @return Position of the '\n' or file_end if the line is the last one.
+         */
+        static const char *nextLineEnd(const char *line_begin, const char *file_end);
+        static constexpr size_t kParseChunkMin = size_t(1) << 20; /// Smallest chunk parsed by a thread.
+        /**
+         * Parses the records of a piece of a .fa File, with the rules of the loader (see readDnaLines).
+         * @param cursor Start of the piece: the start of the File or of a '>' line.
+         * @param file_end End of the piece: the end of the File or the start of a '>' line.
+         * @param alphabet The valid bases.
+         * @param arena Where the residues are allocated (used by this piece only).
+         * @param list_of_Sequences [out] The Sequences found, in order.
+         */
+        static void parseRecords(const char *cursor, const char *file_end, const DNA_sequence::BaseAlphabet &alphabet,
+                                 const std::shared_ptr<DNA_sequence::SequenceArena> &arena,
+                                 std::list<DNA_sequence::Sequence> &list_of_Sequences);
+        /**
+         * Builds the canonical Huffman codes of a histogram.
+         * @param histogram The occurrences of every base.
+         * @param every_valid If not nullptr, every base of this alphabet gets a code even if it was not counted.
+         * @return The codes.
+         */
+        static HuffmanCodeTable codeTableOf(const BaseHistogram &histogram,
+                                            const DNA_sequence::BaseAlphabet *every_valid = nullptr);
+        /**
+         * The Huffman codes a .fabin of the loaded File stores: the ones of its bases out of the long runs.
+         * @param codec How the blocks are encoded (the codes are only built if codecUsesTable).
+         * @return The codes.
+         */
+        HuffmanCodeTable fabinCodeTable(FabinCodec codec) const;
 
 
     public:
@@ -31,45 +88,174 @@ namespace FastaFile {
         ~FASTAFile(); /// Destructor.
         void printInformation(); /// To print information of the File in screen.
         void exportLegible(); /// Export a legible .fa file.
-        int isSubSequence(std::string sub_sequence); /// To fin a subsequence in the Sequences.
-        explicit FASTAFile(std::string &file_name); /// Builder with the file_name.
+        /**
+         * Writes the File as .fa text straight from the residues of every Sequence, through big buffers written
+         * by their own thread.
+         * @param export_file_name The .fa File.
+         * @param line_width Bases per line to re-wrap every Sequence (0 = keep the original DNA Lines).
+         * @param write_fai TRUE to also write export_file_name + ".fai" (samtools faidx format), which needs every
+         * DNA Line of a Sequence but the last one to have the same length (always the case when re-wrapping).
+         * @return FALSE if a File could not be written.
+         */
+        bool exportFasta(const std::string &export_file_name, size_t line_width = 0, bool write_fai = false);
+        int isSubSequence(std::string sub_sequence); /// To count the occurrences of a subsequence in the Sequences.
+        /**
+         * To find every occurrence of a subsequence, also the ones that span line-breaks.
+         *
+         * Uses the search index if it was built (see buildSearchIndex), otherwise a Boyer-Moore-Horspool scan. The
+         * index is built on the kSearchesBeforeIndex-th search of the same File, so only repeated searches pay for it.
+         * @param sub_sequence The subsequence to find.
+         * @return The position (Sequence, offset) of every match.
+         */
+        std::vector<SearchMatch> findSubSequence(const std::string &sub_sequence);
+        /**
+         * Builds the FM-Index of the File, so the next searches are answered in O(M + occ).
+         * @return TRUE if the index is ready.
+         */
+        bool buildSearchIndex();
+        /**
+         * To find many subsequences at once, with a single pass over every Sequence (Aho-Corasick).
+         * @param patterns The subsequences.
+         * @param reverse_complement TRUE to also find the reverse complement of every pattern.
+         * @return The matches of every pattern (and of its reverse complement, right after it).
+         */
+        std::vector<PatternHits> batchSearch(const std::vector<std::string> &patterns, bool reverse_complement);
+        /**
+         * Batch search of the patterns in a file: one pattern per line, a '>' line before a pattern gives its name.
+         * @overload
+         */
+        std::vector<PatternHits> batchSearch(const std::string &patterns_file, bool reverse_complement);
+        /**
+         * Builder with the file_name.
+         * @param file_name The .fa File (with or without extension).
+         * @param alphabet The alphabet used to validate every DNA Line.
+         */
+        explicit FASTAFile(std::string &file_name,
+                           DNA_sequence::AlphabetKind alphabet = DNA_sequence::AlphabetKind::Default);
+        /**
+         * Builder in lazy mode: only the '>' lines are read now, every Sequence is parsed the first time it's asked
+         * for (see sequence) and at most resident_limit of them stay in memory. The operations on the whole File
+         * parse it completely first (see materialize).
+         * @param file_name The .fa File (with or without extension).
+         * @param alphabet The alphabet used to validate every DNA Line.
+         * @param resident_limit Maximum number of Sequences kept in memory.
+         */
+        FASTAFile(std::string &file_name, DNA_sequence::AlphabetKind alphabet, size_t resident_limit);
         explicit FASTAFile(std::string &file_name, const int &bin_opcion); /// Builder for a .fabin input file.
+        bool isLazy() const; /// TRUE if the Sequences are parsed on demand.
+        /**
+         * Parses every Sequence of a lazy File, which stops being lazy (nothing to do otherwise).
+         */
+        void materialize();
+        /**
+         * Finds a Sequence by name (the whole name or its first word); in lazy mode it's parsed if it's not resident.
+         * @param name The name.
+         * @return The Sequence, or nullptr.
+         */
+        std::shared_ptr<DNA_sequence::Sequence> sequence(const std::string &name);
+        /**
+         * To find every occurrence of a subsequence in one Sequence (a lazy File only parses that Sequence).
+         * @param sub_sequence The subsequence to find.
+         * @param sequence_name The Sequence.
+         * @return The position (Sequence, offset) of every match.
+         */
+        std::vector<SearchMatch> findSubSequence(const std::string &sub_sequence, const std::string &sequence_name);
         void HuffmanEncodder(); /// To call the huffman encoder process-
         std::map<char, int> freqMapping(); /// freq_map getter.
-        void compressFile(std::string file_name); /// To transform a .fa File to a .fabin.
-        FASTAFile &operator=(FASTAFile const &obj) {  /// Operator =
-            this->sequences_list_ = obj.sequences_list_;
-            this->mapa_freq_ = obj.mapa_freq_;
-            this->mapa_ = obj.mapa_;
-            this->file_name_ = obj.file_name_;
-            this->empty_file_ = false;
-            this->file_bases_count = obj.file_bases_count;
-            this->DNAsequences_count = obj.DNAsequences_count;
-            return *this;
-        }
-        FASTAFile(const FASTAFile &obj) { /// Copy Builder.
-            this->sequences_list_ = obj.sequences_list_;
-            this->mapa_freq_ = obj.mapa_freq_;
-            this->mapa_ = obj.mapa_;
-            this->file_name_ = obj.file_name_;
-            this->empty_file_ = false;
-            this->file_bases_count = obj.file_bases_count;
-            this->DNAsequences_count = obj.DNAsequences_count;
-        }
+        /**
+         * To transform a .fa File to a .fabin.
+         * @param file_name The name of the .fabin (with or without extension).
+         * @param codec How the bases are encoded.
+         * @param threads Threads used to encode the blocks (0 = defaultThreads(), the --threads knob).
+         */
+        void compressFile(std::string file_name, FabinCodec codec = FabinCodec::Huffman, unsigned threads = 0);
+        /**
+         * Compresses and decompresses the File (to a temporary .fabin) with 1, 2, 4... threads and prints the
+         * throughput of every step, to check how the block codecs scale.
+         * @param codec How the bases are encoded.
+         */
+        void benchmarkScaling(FabinCodec codec);
+        /**
+         * Loads a .fa File and prints the heap allocations of every step: the load itself, moving the File into a
+         * list (as the menu does) and, to compare, copying it. Needs a program built with FASTA_COUNT_ALLOCATIONS.
+         * @param file_name The .fa File (with or without extension).
+         */
+        static void benchmarkAllocations(std::string file_name);
+        /**
+         * Fetches a region without loading the File: from a .fabin, decoding only the blocks that hold it, or from
+         * a .fa (also .fasta, .fna), reading only its lines through the .fai index (built the first time).
+         * @param file_name The .fabin (with or without extension) or .fa File.
+         * @param region "name", "name:start" or "name:start-end" (1-based, inclusive), e.g. chr7:1,000,000-1,001,000.
+         * @param bases [out] The bases of the region.
+         * @return FALSE if the File, the Sequence or the region is not valid.
+         */
+        static bool fetchRegion(std::string file_name, const std::string &region, std::string &bases);
+        /**
+         * Builds the .fai index of a .fa File (samtools faidx format) and writes it to file_name + ".fai".
+         * @param file_name The .fa File (also .fasta, .fna; .fa is added if it has none of them).
+         * @return The number of Sequences indexed, or -1 if the File can't be read or indexed.
+         */
+        static long buildFaiIndex(std::string file_name);
+        /**
+         * Compresses a .fa File to a .fabin while it's read, without loading it: the memory used doesn't depend on
+         * the size of the File. The Sequences are the ones the loader would keep.
+         *
+         * The Huffman codec needs the frequencies first: they are counted in a first pass over the whole File or,
+         * if sampled, over its first kSampleBytes bases only (every valid base still gets a code).
+         * @param fa_file The .fa File (also .fasta, .fna; .fa is added if it has none of them).
+         * @param fabin_file The .fabin File (with or without extension).
+         * @param codec How the bases are encoded.
+         * @param sampled TRUE to take the frequencies from a sample (one pass less).
+         * @param alphabet The alphabet used to validate every DNA Line.
+         * @param threads Threads used to encode the blocks (0 = defaultThreads()).
+         * @return FALSE if a File could not be read or written.
+         */
+        static bool compressStream(std::string fa_file, std::string fabin_file, FabinCodec codec = FabinCodec::Huffman,
+                                   bool sampled = false,
+                                   DNA_sequence::AlphabetKind alphabet = DNA_sequence::AlphabetKind::Default,
+                                   unsigned threads = 0);
+        /**
+         * Decompresses a .fabin File to a .fa File a few blocks at a time, without loading it.
+         * @param fabin_file The .fabin File (with or without extension).
+         * @param fa_file The .fa File (also .fasta, .fna; .fa is added if it has none of them).
+         * @param threads Threads used to decode the blocks (0 = defaultThreads()).
+         * @return FALSE if the .fabin is not valid or the .fa could not be written.
+         */
+        static bool decompressStream(std::string fabin_file, std::string fa_file, unsigned threads = 0);
+        static constexpr uint64_t kSampleBytes = uint64_t(64) << 20; /// Bases counted by the sampled mode.
+        FASTAFile &operator=(FASTAFile const &obj); /// Operator =, copies the residues to a new arena.
+        FASTAFile(const FASTAFile &obj); /// Copy Builder.
+        FASTAFile &operator=(FASTAFile &&obj) noexcept; /// Move Operator =, takes the Sequences and their arena.
+        FASTAFile(FASTAFile &&obj) noexcept; /// Move Builder, nothing is copied nor allocated.
         std::string prepareFileName(std::string &file_name, const std::string &extension); /// To check if a filename contains or not the extension.
+        static bool hasFastaExtension(const std::string &file_name); /// TRUE if it ends in .fa, .fasta or .fna.
         /**
-         * To change every subsequence (To mask) to the char "X".
-         * @param to_mask The subsequence to mask for example: AGGT in AFGT*AGGT*AAT
+         * To change every base of every subsequence (To mask) to the char "X".
+         * @param to_mask The subsequence to mask for example: AGGT in AFGT*AGGT*AAT (matched literally).
          * @overload
          */
         void maskFile(const std::string &to_mask);
         /**
          * To change every subsequence to the other subsequence.
+         *
+         * The pattern is compiled once. If the mask is a single char (every base of the match is changed to it) or
+         * has the length of the subsequence, the bases are masked in place, also across line-breaks and in parallel
+         * over the Sequences; otherwise every line is rebuilt with the replacement.
          * @param to_mask The subsequence to replace.
          * @param mask The replacement subsequence.
+         * @param iupac TRUE to expand the IUPAC codes of to_mask (N matches any base...) and ignore case; by
+         * default it is matched literally (exact bytes, case-sensitive).
          * @overload
          */
-        void maskFile(const std::string &to_mask, const std::string &mask);
+        void maskFile(const std::string &to_mask, const std::string &mask, bool iupac = false);
+        /**
+         * To mask the intervals of a BED file (name, start, end, 0-based half open), in place.
+         * @param bed_file The BED file.
+         * @param soft TRUE to soft-mask (lowercase) instead of changing the bases to mask.
+         * @param mask The char for hard-masking.
+         * @return The number of bases masked.
+         */
+        size_t maskIntervals(const std::string &bed_file, bool soft, char mask = 'X');
         /**
          * To call the Huffman Encoder but with auto mask replacement.
          * @param Mask
@@ -0,0 +1,169 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_FASTASTREAM_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_FASTASTREAM_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "BaseAlphabet.h"
+#include "IoPipeline.h"
+
+namespace FastaFile {
+    /**
+     * Reads the lines of a file through the read-ahead stage (see InputPipeline).
+     *
+     * The lines are handed out as views into the chunks, so memory doesn't depend on the size of the file; only a
+     * line that crosses two chunks is copied.
+     */
+    class FastaLineReader {
+    private:
+        InputPipeline input_; /// The file, read ahead by its own thread.
+        IoBuffer chunk_; /// The chunk being scanned.
+        bool has_chunk_ = false; /// TRUE if chunk_ holds a chunk.
+        size_t begin_ = 0; /// First byte of chunk_ not handed out yet.
+        std::string carry_; /// A line that crosses two chunks.
+        uint64_t bytes_read_ = 0; /// Bytes read from the file.
+        bool unterminated_ = false; /// TRUE if the last line had no line-break.
+
+    public:
+        /**
+         * Opens the file.
+         * @param file_name The file.
+         */
+        explicit FastaLineReader(const std::string &file_name) : input_(file_name) {}
+        /// TRUE if the file could be opened.
+        bool good() const {
+            return input_.good();
+        }
+        /// TRUE if a read failed.
+        bool failed() const {
+            return input_.failed();
+        }
+        /**
+         * The next line, without its '\n'.
+         * @param line [out] The line, valid until the next call.
+         * @return FALSE at the end of the file.
+         */
+        bool next(std::string_view &line) {
+            carry_.clear();
+            bool carrying = false;
+            while (true) {
+                if (has_chunk_) {
+                    const char *data = chunk_.bytes_.data() + begin_;
+                    size_t size = chunk_.used_ - begin_;
+                    auto line_end = size > 0 ? static_cast<const char *>(memchr(data, '\n', size)) : nullptr;
+                    if (line_end != nullptr) {
+                        auto length = size_t(line_end - data);
+                        begin_ += length + 1;
+                        if (!carrying) {
+                            line = std::string_view(data, length);
+                            return true;
+                        }
+                        carry_.append(data, length);
+                        line = carry_;
+                        return true;
+                    }
+                    carry_.append(data, size); //The line goes on in the next chunk.
+                    carrying = true;
+                    input_.release(chunk_);
+                    has_chunk_ = false;
+                }
+                if (!input_.next(chunk_)) { //The last line may not have a line-break.
+                    line = carry_;
+                    if (carry_.empty()) return false;
+                    unterminated_ = true;
+                    return true;
+                }
+                has_chunk_ = true;
+                begin_ = 0;
+                bytes_read_ += chunk_.used_;
+            }
+        }
+        /// TRUE if the file ended without a line-break (known once next() returned FALSE).
+        bool unterminated() const {
+            return unterminated_;
+        }
+        /// Bytes read from the file so far.
+        uint64_t bytesRead() const {
+            return bytes_read_;
+        }
+    };
+
+    /**
+     * Streams the records of a .fa File with the rules of the FASTAFile loader: a record starts at a '>' line and
+     * its DNA Lines run until the next '>' line, an empty line or the end; only the lines made of valid bases are
+     * DNA Lines. Unlike the loader, a line that is only valid in uppercase (soft-masked bases) is a DNA Line too.
+     * Nothing but the current line is held in memory.
+     *
+     * The handler is called as handler.header(name) for every record, handler.line(line, original) for every
+     * DNA Line (line in uppercase, original as it was read; it returns FALSE to stop reading),
+     * handler.end(max_length, valid_lines) at the end of every record (max_length counts the invalid lines too,
+     * like Sequence::addLine does), handler.other(line) for every other line (before the first record, invalid,
+     * empty or after an empty line), and handler.finish(line_break) once the whole File was read (line_break is
+     * FALSE if its last line had no line-break). Together they see every byte of the File.
+     * @param file_name The .fa File.
+     * @param alphabet The valid bases.
+     * @param handler The handler.
+     * @return Bytes read, or -1 if the File can't be opened or read.
+     */
+    template<typename Handler>
+    int64_t streamFasta(const std::string &file_name, const DNA_sequence::BaseAlphabet &alphabet, Handler &handler) {
+        FastaLineReader reader(file_name);
+        if (!reader.good()) return -1;
+        std::string_view line;
+        std::string folded; //A line in uppercase.
+        bool in_record = false;
+        size_t max_length = 0, valid_lines = 0;
+        while (reader.next(line)) {
+            if (!line.empty() && line[0] == '>') {
+                if (in_record) handler.end(max_length, valid_lines);
+                in_record = true;
+                max_length = 0;
+                valid_lines = 0;
+                handler.header(std::string(line.substr(1)));
+                continue;
+            }
+            if (!in_record) { //Before the first record, or after an empty line.
+                handler.other(line);
+                continue;
+            }
+            if (line.empty()) {
+                handler.end(max_length, valid_lines);
+                in_record = false;
+                handler.other(line);
+                continue;
+            }
+            max_length = std::max(max_length, line.size());
+            std::string_view bases = line;
+            size_t valid = alphabet.validPrefix(line.data(), line.size());
+            if (valid < line.size()) { //Maybe soft-masked.
+                folded.assign(line);
+                for (size_t i = valid; i < folded.size(); i++) {
+                    folded[i] = char(toupper(static_cast<unsigned char>(folded[i])));
+                }
+                if (alphabet.validPrefix(folded.data() + valid, folded.size() - valid) != folded.size() - valid) {
+                    handler.other(line);
+                    continue;
+                }
+                bases = folded;
+            }
+            valid_lines++;
+            if (!handler.line(bases, line)) {
+                handler.end(max_length, valid_lines);
+                return reader.failed() ? -1 : int64_t(reader.bytesRead());
+            }
+        }
+        if (in_record) handler.end(max_length, valid_lines);
+        handler.finish(!reader.unterminated());
+        return reader.failed() ? -1 : int64_t(reader.bytesRead());
+    }
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_FASTASTREAM_H
@@ -0,0 +1,136 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_HISTOGRAM_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <list>
+#include <string_view>
+#include <vector>
+#include "Parallel.h"
+#include "RunLength.h"
+#include "Sequence.h"
+
+namespace FastaFile {
+    /**
+     * 256-bin histogram of the bytes of one or more Sequences.
+     *
+     * Counting is done in a single pass. The kernel keeps four interleaved sets of 32-bit counters, so consecutive
+     * equal bases (very common in DNA) don't serialize on the same counter, and folds them into the 64-bit bins
+     * before they can overflow. Big inputs are cut into pieces counted by several threads in their own
+     * sub-histograms, which are merged at the end.
+     */
+    class BaseHistogram {
+    private:
+        std::array<uint64_t, 256> bins_{}; /// Occurrences of every byte.
+        static constexpr size_t kPieceSize = size_t(1) << 20; /// Bytes per parallel task.
+        static constexpr size_t kParallelMin = size_t(4) << 20; /// Below this size threads don't pay off.
+        static constexpr size_t kSmallCount = 4096; /// Below this size the bins are counted directly.
+
+    public:
+        /**
+         * Counts every byte of the buffer.
+         * @param data The first byte.
+         * @param size Number of bytes.
+         */
+        void count(const char *data, size_t size) {
+            auto bytes = reinterpret_cast<const unsigned char *>(data);
+            if (size < kSmallCount) { //Short records (metagenomes): not worth clearing the sub-counters.
+                for (size_t i = 0; i < size; i++) bins_[bytes[i]]++;
+                return;
+            }
+            while (size > 0) {
+                size_t step = std::min<size_t>(size, size_t(1) << 30); // 32-bit sub-counters can't overflow.
+                uint32_t sub[4][256] = {};
+                size_t i = 0;
+                for (; i + 4 <= step; i += 4) {
+                    sub[0][bytes[i]]++;
+                    sub[1][bytes[i + 1]]++;
+                    sub[2][bytes[i + 2]]++;
+                    sub[3][bytes[i + 3]]++;
+                }
+                for (; i < step; i++) sub[0][bytes[i]]++;
+                for (int c = 0; c < 256; c++) {
+                    bins_[c] += uint64_t(sub[0][c]) + sub[1][c] + sub[2][c] + sub[3][c];
+                }
+                bytes += step;
+                size -= step;
+            }
+        }
+        /**
+         * Counts the bytes of the buffer that the .fabin entropy codecs code (the ones outside the long runs, see
+         * RunLength). A byte that only appears in runs keeps a count of 1, it may still be coded elsewhere.
+         * @param data The first byte.
+         * @param size Number of bytes.
+         */
+        void countWithoutRuns(const char *data, size_t size) {
+            count(data, size);
+            std::vector<BaseRun> runs;
+            RunLength::find(std::string_view(data, size), runs);
+            for (const BaseRun &run: runs) {
+                uint64_t &bin = bins_[static_cast<unsigned char>(run.base_)];
+                bin = std::max<uint64_t>(bin - run.length_, 1);
+            }
+        }
+        /// Adds the bins of another histogram.
+        void merge(const BaseHistogram &other) {
+            for (int c = 0; c < 256; c++) bins_[c] += other.bins_[c];
+        }
+        /// Adds the lowercase letters to the uppercase ones (the .fabin blocks hold soft-masked bases in uppercase).
+        void foldCase() {
+            for (int c = 'a'; c <= 'z'; c++) {
+                bins_[c - 'a' + 'A'] += bins_[c];
+                bins_[c] = 0;
+            }
+        }
+        /// Occurrences of the given byte.
+        uint64_t operator[](unsigned char c) const {
+            return bins_[c];
+        }
+        /// Total of bytes counted.
+        uint64_t total() const {
+            uint64_t sum = 0;
+            for (auto bin: bins_) sum += bin;
+            return sum;
+        }
+        /**
+         * Histogram of the residues of every Sequence in the list.
+         * @param sequences The Sequences.
+         * @param threads Number of threads (0 = defaultThreads()).
+         * @param without_runs TRUE to leave out the long runs (see countWithoutRuns).
+         * @return The merged histogram.
+         */
+        static BaseHistogram ofSequences(const std::list<DNA_sequence::Sequence> &sequences, unsigned threads = 0,
+                                         bool without_runs = false) {
+            std::vector<std::string_view> pieces; // Residues cut in pieces of at most kPieceSize bytes.
+            size_t total_size = 0;
+            for (const auto &sequence: sequences) {
+                std::string_view residues = sequence.residues();
+                total_size += residues.size();
+                for (size_t offset = 0; offset < residues.size(); offset += kPieceSize) {
+                    pieces.push_back(residues.substr(offset, kPieceSize));
+                }
+            }
+            if (total_size < kParallelMin) threads = 1;
+            if (threads == 0) threads = defaultThreads();
+            std::vector<BaseHistogram> partial(threads); // One sub-histogram per worker.
+            unsigned used = parallelFor(pieces.size(), [&](size_t index, unsigned worker) {
+                if (without_runs) {
+                    partial[worker].countWithoutRuns(pieces[index].data(), pieces[index].size());
+                } else {
+                    partial[worker].count(pieces[index].data(), pieces[index].size());
+                }
+            }, threads);
+            BaseHistogram result;
+            for (unsigned w = 0; w < used; w++) result.merge(partial[w]);
+            return result;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_HISTOGRAM_H
@@ -6,30 +6,219 @@
 #define FASTA_BASIC_TEXT_FILE_MANAGER_HUFFMAN_H
 
 #include <iostream>
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <map>
 #include <vector>
+#include <string>
+#include <string_view>
+#include "BitStream.h"
+
+constexpr unsigned kMaxCodeLength = 24; /// Longest code written to a .fabin File.
+
+/**
+ * Bounds the code lengths to max_length bits, keeping a complete prefix code.
+ *
+ * Every code longer than max_length is cut to max_length; then, while the lengths overflow the Kraft sum, a
+ * max_length code is taken out and a shorter code is split in two (JPEG, Annex K.3). The new lengths are given
+ * back to the bytes in the order of their original lengths, so the most frequent ones keep the shortest codes.
+ * @param length [in/out] The length of the code of every byte (0 = the byte has no code).
+ * @param max_length The bound.
+ */
+inline void limitCodeLengths(uint8_t length[256], unsigned max_length) {
+    bool overflow = false;
+    for (int c = 0; c < 256; c++) overflow |= length[c] > max_length;
+    if (!overflow) return;
+    uint32_t start[257] = {}; //Counting sort of the bytes by (length, byte).
+    for (int c = 0; c < 256; c++) {
+        if (length[c] > 0) start[length[c] + 1]++;
+    }
+    for (int bits = 2; bits <= 256; bits++) start[bits] += start[bits - 1];
+    int order[256];
+    int present = 0;
+    for (int c = 0; c < 256; c++) {
+        if (length[c] > 0) {
+            order[start[length[c]]++] = c;
+            present++;
+        }
+    }
+    uint32_t counts[256] = {}; //Codes per length.
+    for (int i = 0; i < present; i++) counts[std::min<unsigned>(length[order[i]], max_length)]++;
+    uint64_t kraft = 0; //In units of 2^-max_length.
+    for (unsigned bits = 1; bits <= max_length; bits++) kraft += uint64_t(counts[bits]) << (max_length - bits);
+    while (kraft > (uint64_t(1) << max_length)) {
+        counts[max_length]--;
+        for (unsigned bits = max_length - 1; bits > 0; bits--) {
+            if (counts[bits] > 0) {
+                counts[bits]--;
+                counts[bits + 1] += 2;
+                break;
+            }
+        }
+        kraft--;
+    }
+    int next = 0;
+    for (unsigned bits = 1; bits <= max_length; bits++) {
+        for (uint32_t i = 0; i < counts[bits]; i++) length[order[next++]] = uint8_t(bits);
+    }
+}
 
 /**
- * Implementation of the Huffman Tree
+ * Minimum-redundancy code lengths of the given frequencies, computed in place over a sorted array instead of a
+ * tree (Moffat and Katajainen, "In-place calculation of minimum-redundancy codes", 1995).
  *
- * Huffman is an algorithm that takes a frequency table from a text and returns a codification table using a
- * Binary Tree Ordered (Using Heapify) and a simple translation (Tree/Heap -> Codification table) method.
+ * The symbols are sorted by frequency in a fixed array; a first pass merges them left to right and keeps the
+ * parent of every internal node in the same array, a second pass turns the parents into depths and a third one
+ * gives every leaf its length. Nothing is allocated (two arrays of 256 on the stack), so a table can be rebuilt
+ * for every block. The lengths are then bounded to max_length (see limitCodeLengths).
+ * @param frequency The occurrences of every byte (0 = the byte has no code).
+ * @param length [out] The length of the code of every byte (0 = the byte has no code).
+ * @param max_length The bound.
+ */
+inline void huffmanCodeLengths(const uint64_t frequency[256], uint8_t length[256],
+                               unsigned max_length = kMaxCodeLength) {
+    uint64_t weight[256]; //Ascending frequencies, then parents, then depths.
+    unsigned char symbol[256]; //The byte of every leaf of weight.
+    int n = 0;
+    memset(length, 0, 256);
+    for (int c = 0; c < 256; c++) {
+        if (frequency[c] > 0) symbol[n++] = static_cast<unsigned char>(c);
+    }
+    if (n == 0) return;
+    if (n == 1) { //A lone symbol still takes one bit.
+        length[symbol[0]] = 1;
+        return;
+    }
+    std::sort(symbol, symbol + n, [&](unsigned char a, unsigned char b) {
+        return frequency[a] != frequency[b] ? frequency[a] < frequency[b] : a < b;
+    });
+    for (int i = 0; i < n; i++) weight[i] = frequency[symbol[i]];
+    weight[0] += weight[1]; //First pass: merge the two smallest items, leaves (from leaf) or nodes (from root).
+    int root = 0, leaf = 2;
+    for (int next = 1; next < n - 1; next++) {
+        if (leaf >= n || weight[root] < weight[leaf]) {
+            weight[next] = weight[root];
+            weight[root++] = uint64_t(next);
+        } else {
+            weight[next] = weight[leaf++];
+        }
+        if (leaf >= n || (root < next && weight[root] < weight[leaf])) {
+            weight[next] += weight[root];
+            weight[root++] = uint64_t(next);
+        } else {
+            weight[next] += weight[leaf++];
+        }
+    }
+    weight[n - 2] = 0; //Second pass: the depth of every internal node.
+    for (int next = n - 3; next >= 0; next--) weight[next] = weight[weight[next]] + 1;
+    int available = 1, used = 0, depth = 0, next = n - 1; //Third pass: the depth of every leaf.
+    root = n - 2;
+    while (available > 0) {
+        while (root >= 0 && weight[root] == uint64_t(depth)) {
+            used++;
+            root--;
+        }
+        while (available > used) {
+            weight[next--] = uint64_t(depth);
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+    for (int i = 0; i < n; i++) length[symbol[i]] = uint8_t(std::min<uint64_t>(weight[i], 255));
+    limitCodeLengths(length, max_length);
+}
+
+/**
+ * Canonical codes for the given code lengths: the symbols are sorted by (length, byte) and get consecutive codes,
+ * so the lengths alone describe the whole code and the decoder can rebuild it without the tree.
+ * @param length The length of the code of every byte (0 = the byte has no code).
+ * @param code [out] The canonical code of every byte, right aligned.
+ */
+inline void canonicalCodes(const uint8_t length[256], uint64_t code[256]) {
+    uint32_t count[65] = {}; //Codes per length.
+    for (int c = 0; c < 256; c++) {
+        if (length[c] <= 64) count[length[c]]++;
+    }
+    count[0] = 0;
+    uint64_t next[65] = {}; //Next code of every length.
+    for (unsigned bits = 1; bits <= 64; bits++) next[bits] = (next[bits - 1] + count[bits - 1]) << 1;
+    for (int c = 0; c < 256; c++) { //Bytes in order, so equal lengths get consecutive codes.
+        if (length[c] > 0 && length[c] <= 64) code[c] = next[length[c]]++;
+    }
+}
+
+/**
+ * Appends the code lengths to a buffer: the number of symbols (16 bits) and a (byte, length) pair per symbol.
+ * @param buffer Where the lengths are appended.
+ * @param length The length of the code of every byte (0 = the byte has no code).
+ */
+inline void appendCodeLengths(std::string &buffer, const uint8_t length[256]) {
+    uint16_t symbols = 0;
+    for (int c = 0; c < 256; c++) symbols += length[c] > 0;
+    buffer.append(reinterpret_cast<const char *>(&symbols), sizeof(symbols));
+    for (int c = 0; c < 256; c++) {
+        if (length[c] == 0) continue;
+        buffer.push_back(char(c));
+        buffer.push_back(char(length[c]));
+    }
+}
+
+/**
+ * TRUE if the code lengths can be the ones of a prefix code: none above kMaxCodeLength and a Kraft sum of 1 or
+ * less (a longer length or an over-subscribed code can only come from a corrupted File).
+ * @param length The length of the code of every byte (0 = the byte has no code).
+ */
+inline bool validCodeLengths(const uint8_t length[256]) {
+    uint64_t kraft = 0; //In units of 2^-kMaxCodeLength.
+    for (int c = 0; c < 256; c++) {
+        if (length[c] > kMaxCodeLength) return false;
+        if (length[c] > 0) kraft += uint64_t(1) << (kMaxCodeLength - length[c]);
+    }
+    return kraft <= (uint64_t(1) << kMaxCodeLength);
+}
+
+/**
+ * Reads the code lengths written by appendCodeLengths.
+ * @param data The first byte.
+ * @param end One past the last byte.
+ * @param length [out] The length of the code of every byte (0 = the byte has no code).
+ * @return The first byte after the lengths, or nullptr if they don't fit in the buffer or are not valid
+ * (see validCodeLengths).
+ */
+inline const char *readCodeLengths(const char *data, const char *end, uint8_t length[256]) {
+    memset(length, 0, 256);
+    uint16_t symbols;
+    if (size_t(end - data) < sizeof(symbols)) return nullptr;
+    memcpy(&symbols, data, sizeof(symbols));
+    data += sizeof(symbols);
+    if (size_t(end - data) < size_t(symbols) * 2) return nullptr;
+    for (uint16_t i = 0; i < symbols; i++, data += 2) {
+        length[static_cast<unsigned char>(data[0])] = uint8_t(data[1]);
+    }
+    return validCodeLengths(length) ? data : nullptr;
+}
+
+/**
+ * Implementation of the Huffman codification
+ *
+ * Huffman is an algorithm that takes a frequency table from a text and returns a codification table. The code
+ * lengths are computed over a sorted array (see huffmanCodeLengths), without building the tree, and the codes are
+ * the canonical ones for those lengths (see canonicalCodes).
  * Example:
  *  Text: Mr. Dr. Thorium.
  *  Frequency Table: D:1 R:3 T:1 H:1 O:1 I:1 U:1 M:2 (Which is a std::map (char, int)).
- *  - Huffman Tree (Heap Representation): TOP->(D, T, H, O, I, U, M, R)
- *  Codification Table (Returned): R: 10, M: 01, H: 00, O: 110, I: 1111, U: 11101, D: 111001, T: 111000.
+ *  Codification Table (Returned): R: 00, I: 010, M: 011, O: 100, T: 101, U: 110, D: 1110, H: 1111.
  *  The codification value is a simple vector of ints (1,0,) that represents a bits stream.
  *  So, from the original text: Mr. Dr. Thorium (we're excluding spaces and "." for the example),
  *  MRDRTHORIUM
  *  we will have using the Huffman encoding the binary set:
- *  011011100110111000001101011111110101+0000 (we complete the Final Zeros)
- *  Which is only 36(+4=40) bits long (5 bytes).
- *  If we use the char original bit stream we will have:
- *  0100110101010010010001000101001001010100010010000100111101010010010010010101010101001101
- *  Which is 88 bits long (11 bytes).
- * Therefore, for the last example we have a 1:2 Compression Rate.
+ *  01100111000101111110000010110011 (no Final Zeros needed)
+ *  Which is only 32 bits long (4 bytes).
+ *  If we use the char original bit stream we will have 88 bits (11 bytes).
+ * Therefore, for the last example we have a 1:2.75 Compression Rate.
  *
  */
 class Huffman{
@@ -37,223 +226,308 @@ private:
     /// The Data Structure where the final Codification Table is saved.
     std::map<char, std::vector<int>> freq_map;
 
+public:
+    /// Getter
+    const std::map<char, std::vector<int>> &getFreqMap() const {
+        return freq_map;
+    }
+    ///To print the encoding results in the terminal.
+    void printCodes(){
+        for (auto &x : this->freq_map){
+            std::string output_string;
+            for (auto &y : x.second){
+                output_string += std::to_string(y);
+            }
+            std::cout << x.first << " : " << output_string << std::endl;
+        }
+    }
+    ///The Main Function that receives the frequency tables and do the encoding.
+    void huffmanEncoder(char codes[], int freqs[], int size){
+        uint64_t frequency[256] = {};
+        for (int i = 0; i < size; i++) frequency[static_cast<unsigned char>(codes[i])] = uint64_t(std::max(freqs[i], 1));
+        uint8_t length[256];
+        uint64_t code[256] = {};
+        huffmanCodeLengths(frequency, length);
+        canonicalCodes(length, code);
+        this->freq_map.clear();
+        for (int c = 0; c < 256; c++) {
+            if (length[c] == 0) continue;
+            std::vector<int> &bits = this->freq_map[char(c)];
+            for (int bit = length[c] - 1; bit >= 0; bit--) bits.push_back(int((code[c] >> bit) & 1));
+        }
+    }
+};
+
+/**
+ * Flat encoding table: the canonical Huffman code of every byte as a (code, length) pair.
+ *
+ * Only the code lengths are kept, bounded to kMaxCodeLength, and the codes themselves are
+ * re-assigned canonically (see canonicalCodes), so the lengths are all a .fabin File needs to store. Encoding a
+ * base is a table load and a BitWriter::put, instead of strings of '0'/'1' chars.
+ */
+class HuffmanCodeTable {
 private:
-    /**
-     * The Huffman Node Data Structure for the Tree/heap which contains the freq, the char and the L-R references.
-     */
-    struct HuffmanNode{
-        unsigned freq_; /// Each Huffman Node has the frequency of the char.
-        char char_code_; /// The char.
-        struct HuffmanNode *left, *right; /// The next pointers, building a tree.
-    };
-    /**
-     * The Max Heap Data Structure, saving the size of the Heap n-elements(size_).
-     * The Array contains the Heap, which is an array of Huffman Nodes ordered (inverse).
-     */
-    struct MaxHeap{
-        unsigned size_; /// The size of the array, also the amount of chars.
-        struct HuffmanNode **array_; /// The array that builds the Heap.
-    };
-    /**
-     * Creates a HuffmanNode.
-     *
-     * @param code the Char-Code (ASCII) to save.
-     * @param freq the frequency (times that the char appears in the sequence).
-     * @return The Huffman Node Structure.
-     */
-    static struct HuffmanNode *newNode(char code, unsigned freq){
-        auto *temp = new HuffmanNode;
-        temp->left = temp->right = nullptr;
-        temp->char_code_ = code;
-        temp->freq_ = freq;
-        return temp;
+    uint32_t packed_[256] = {}; /// The code of every byte, right aligned, above its length (low 8 bits).
+    uint8_t length_[256] = {}; /// The length of every code (0 = the byte has no code).
+
+    /// Packs the canonical codes of length_.
+    void pack() {
+        uint64_t code[256] = {};
+        canonicalCodes(length_, code);
+        for (int c = 0; c < 256; c++) packed_[c] = uint32_t(code[c] << 8) | length_[c];
     }
+
+public:
     /**
-     * Creates a MaxHeap.
-     *
-     * @param size INT that indicates the amount of the Nodes that have the array (the Heap).
-     * @return the Heap.
+     * Constructor.
+     * @param codes The codification table (char -> vector of 1's and 0's), only the lengths are used.
      */
-    static struct MaxHeap *newMaxHeap(unsigned size){
-        auto *temp = new MaxHeap;
-        temp->size_ = size;
-        temp->array_ = (struct HuffmanNode **) malloc(temp->size_ * sizeof (struct HuffmanNode *));
-        return temp;
+    explicit HuffmanCodeTable(const std::map<char, std::vector<int>> &codes) {
+        for (auto &entry: codes) length_[static_cast<unsigned char>(entry.first)] = uint8_t(entry.second.size());
+        if (codes.size() == 1) length_[static_cast<unsigned char>(codes.begin()->first)] = 1; //A lone symbol has an empty code.
+        limitCodeLengths(length_, kMaxCodeLength);
+        pack();
     }
     /**
-     * Swap two Nodes to order the Heap in Heapify.
-     *
-     * @param a The First HuffmanNode.
-     * @param b The Second HufmanNode.
+     * Constructor, builds the codes straight from the frequencies (nothing is allocated, see huffmanCodeLengths).
+     * @param frequency The occurrences of every byte (0 = the byte has no code).
      */
-    static void swapHuffmanNode(struct HuffmanNode **a, struct HuffmanNode **b) {
-        struct HuffmanNode *t = *a;
-        *a = *b;
-        *b = t;
+    explicit HuffmanCodeTable(const uint64_t frequency[256]) {
+        huffmanCodeLengths(frequency, length_, kMaxCodeLength);
+        pack();
     }
     /**
-     * Takes a Heap and check the position (of index) if the right/left element is bigger or not
-     * in order to order the heap. Uses the Swap Function and it's recursive.
-     *
-     * @param maxHeap The Heap that needs to be Heapify.
-     * @param index The position to check for the recursive function.
+     * Constructor.
+     * @param length The length of the code of every byte (0 = the byte has no code), at most kMaxCodeLength.
      */
-
-    void maxHeapify(struct MaxHeap *maxHeap, int index){
-        int biggest = index;
-        int left = 2 * index + 1;
-        int right = 2 * index + 2;
-        if (left < maxHeap->size_ && maxHeap->array_[left]->freq_ < maxHeap->array_[biggest]->freq_)
-            biggest = left;
-        if (right < maxHeap->size_ && maxHeap->array_[right]->freq_ < maxHeap->array_[biggest]->freq_)
-            biggest = right;
-        if (biggest != index){
-            swapHuffmanNode(&maxHeap->array_[biggest], &maxHeap->array_[index]);
-            maxHeapify(maxHeap, biggest);
+    explicit HuffmanCodeTable(const uint8_t length[256]) {
+        memcpy(length_, length, sizeof(length_));
+        pack();
+    }
+    /// The codification table (char -> vector of 1's and 0's) of the canonical codes.
+    std::map<char, std::vector<int>> codification() const {
+        std::map<char, std::vector<int>> codes;
+        for (int c = 0; c < 256; c++) {
+            if (length_[c] == 0) continue;
+            std::vector<int> &bits = codes[char(c)];
+            for (int bit = length_[c] - 1; bit >= 0; bit--) bits.push_back(int((packed_[c] >> (8 + bit)) & 1));
         }
+        return codes;
     }
-    /**
-     * A simply bool to check the size of the Heap.
-     *
-     * @param maxHeap
-     * @return TRUE -> The Size of the Heap == 1;
-     * @return FALSE -> Otherwise.
-     */
-    static bool isSizeOne(struct MaxHeap *maxHeap){
-        return (maxHeap->size_ == 1);
+    /// The length of the code of every byte.
+    const uint8_t *lengths() const {
+        return length_;
+    }
+    /// The code of a byte, right aligned, above its length (low 8 bits).
+    uint32_t packed(unsigned char byte) const {
+        return packed_[byte];
     }
     /**
-     * Deletes the first element of the given Heap and returns that element.
-     *
-     * @param maxHeap The Heap.
-     * @return The HuffmanNode of the first position.
+     * Bits taken by the codes of the given bytes.
+     * @param frequency The occurrences of every byte.
+     * @return The bits, or UINT64_MAX if a byte that occurs has no code.
      */
-    struct HuffmanNode *extractMax(struct MaxHeap *maxHeap){
-        struct HuffmanNode *temp = maxHeap->array_[0];
-        maxHeap->array_[0] = maxHeap->array_[maxHeap->size_ - 1];
-        --maxHeap->size_;
-        maxHeapify(maxHeap, 0);
-        return temp;
+    uint64_t cost(const uint64_t frequency[256]) const {
+        uint64_t bits = 0;
+        for (int c = 0; c < 256; c++) {
+            if (frequency[c] == 0) continue;
+            if (length_[c] == 0) return UINT64_MAX;
+            bits += frequency[c] * length_[c];
+        }
+        return bits;
     }
     /**
-     * insert a new HuffmanNode in the Heap in the last position
-     *
-     * @param maxHeap
-     * @param huffmanNode
+     * Encodes every byte of the text.
+     * @param text The bases.
+     * @param writer Where the codes are written.
+     * @return FALSE if a byte has no code (it can't be written, the output is not valid).
      */
-    static void insertMaxHeap(struct MaxHeap *maxHeap, struct HuffmanNode *huffmanNode){
-        ++maxHeap->size_;
-        unsigned i = maxHeap->size_ - 1;
-        while ( i && huffmanNode->freq_ < maxHeap->array_[(i-1)/2]->freq_){
-            maxHeap->array_[i] = maxHeap->array_[(i-1)/2];
-            i = (i-1)/2;
+    bool encode(std::string_view text, BitWriter &writer) const {
+        for (char c: text) {
+            uint32_t entry = packed_[static_cast<unsigned char>(c)]; //One load per base.
+            if ((entry & 0xff) == 0) return false;
+            writer.put(entry >> 8, entry & 0xff);
         }
-        maxHeap->array_[i] = huffmanNode;
-    }
-    /// To check if is a leaf the given node.
-    static bool isLeaf(struct HuffmanNode *root){
-        return !(root->left) && !(root->right);
+        return true;
     }
+};
+
+/**
+ * Table-driven decoder of canonical Huffman codes.
+ *
+ * Built once per File from the code lengths. Every step looks at the next kTableBits bits of the stream and a
+ * single load of the lookup table gives every complete code inside them (up to 4, a DNA base takes 2 or 3 bits),
+ * so the serial dependency of the bit position is paid once per group of bases instead of once per base. Codes
+ * longer than kTableBits fall back to the canonical limits, one comparison per extra bit.
+ */
+class HuffmanDecoder {
+private:
+    static constexpr unsigned kTableBits = 11; /// Bits resolved by a single table load.
+    /// The codes that fit in a kTableBits prefix.
+    struct Entry {
+        uint32_t symbols_; /// Up to 4 bytes, the first one in the low byte.
+        uint8_t count_; /// Number of bytes (0 = the first code is longer than kTableBits).
+        uint8_t bits_; /// Bits taken by those codes.
+    };
+    Entry table_[1u << kTableBits] = {}; /// Entry of every kTableBits prefix.
+    uint64_t first_[65] = {}; /// First canonical code of every length.
+    uint32_t count_[65] = {}; /// Number of codes of every length.
+    uint32_t offset_[65] = {}; /// Position in symbols_ of the first code of every length.
+    unsigned char symbols_[256] = {}; /// The bytes, sorted by (length, byte).
+    uint8_t max_length_ = 0; /// The longest code.
+
     /**
-     * Heapify the entire given Heap.
-     *
-     * @param the maxHeap
+     * Decodes the code at the top of the window, if it has at most limit bits.
+     * @return The length of the code (0 if it's longer than limit), the byte in symbol.
      */
-    void buildMaxHeap(struct MaxHeap *maxHeap){
-        maxHeapify(maxHeap, 0);
-        int n = maxHeap->size_ - 1;
-        int i = (n-1)/2;
-        for (; i > 0; i--){
-            maxHeapify(maxHeap, int(i));
+    uint8_t decodeOne(uint64_t window, unsigned limit, unsigned char &symbol) const {
+        uint64_t code = 0;
+        for (uint8_t bits = 1; bits <= limit && bits <= max_length_; bits++) {
+            code = (code << 1) | ((window >> (64 - bits)) & 1);
+            if (code - first_[bits] < count_[bits]) {
+                symbol = symbols_[offset_[bits] + (code - first_[bits])];
+                return bits;
+            }
         }
+        return 0;
     }
+
+public:
     /**
-     * Creates the Heap using the frequency table.
-     *
-     * @param codes The char array of the freq. Table.
-     * @param freqs The int array of the freq. Table.
-     * @param size  (int) The N chars is present in the codes.
-     * @return the Heap.
+     * Constructor.
+     * @param length The length of the code of every byte (0 = the byte has no code).
      */
-    struct MaxHeap *createMaxHeap(char codes[], int freqs[], int size){
-        struct MaxHeap *maxHeap = newMaxHeap(size);
-        for (int i = 0; i < size; i++){
-            maxHeap->array_[i] = newNode(codes[i], freqs[i]);
+    explicit HuffmanDecoder(const uint8_t length[256]) {
+        uint64_t code[256] = {};
+        canonicalCodes(length, code);
+        uint32_t position = 0;
+        for (uint8_t bits = 1; bits <= 64; bits++) {
+            offset_[bits] = position;
+            for (int c = 0; c < 256; c++) {
+                if (length[c] != bits) continue;
+                if (count_[bits]++ == 0) first_[bits] = code[c];
+                symbols_[position++] = static_cast<unsigned char>(c);
+                max_length_ = bits;
+            }
+        }
+        for (uint64_t prefix = 0; prefix < (uint64_t(1) << kTableBits); prefix++) {
+            Entry &entry = table_[prefix];
+            uint64_t window = prefix << (64 - kTableBits);
+            unsigned char symbol = 0;
+            uint8_t bits;
+            while (entry.count_ < 4 && (bits = decodeOne(window, kTableBits - entry.bits_, symbol)) > 0) {
+                entry.symbols_ |= uint32_t(symbol) << (8 * entry.count_);
+                entry.count_++;
+                entry.bits_ += bits;
+                window <<= bits;
+            }
         }
-        maxHeap->size_ = size;
-        buildMaxHeap(maxHeap);
-        return maxHeap;
     }
     /**
-     * Creates the Data Structure of the Huffman (Tree).
-     *
-     * @param codes The char array of the freq. Table.
-     * @param freqs The int array of the freq. Table.
-     * @param size  (int) The N chars is present in the codes.
-     * @return The first element of the Huffman (root).
+     * Decodes a number of bytes.
+     * @param reader The bit stream.
+     * @param out Where the bytes are written.
+     * @param count Number of bytes to decode.
+     * @return FALSE if the stream has a code that doesn't exist.
      */
-    struct HuffmanNode *buildHuffman(char codes[], int freqs[], int size){
-        struct HuffmanNode *left, *right, *top;
-        struct MaxHeap *maxHeap = createMaxHeap(codes, freqs, size);
-        while(!isSizeOne(maxHeap)){
-            left = extractMax(maxHeap);
-            right = extractMax(maxHeap);
-            top = newNode('$', left->freq_ + right->freq_);
-            top->left = left;
-            top->right = right;
-            insertMaxHeap(maxHeap, top);
+    bool decode(BitReader &reader, char *out, size_t count) const {
+        const uint64_t *words = reader.words(); //Locals, so the stores to out don't force reloads.
+        const size_t words_count = reader.count();
+        const size_t fast_end = words_count > 1 ? (words_count - 1) * 64 : 0; //Below it both words can be read.
+        size_t position = reader.position();
+        size_t i = 0;
+        while (i < count) {
+            uint64_t window;
+            if (position < fast_end) {
+                unsigned offset = unsigned(position & 63);
+                window = (words[position >> 6] << offset) | ((words[(position >> 6) + 1] >> 1) >> (63 - offset));
+            } else {
+                window = BitReader::windowAt(words, words_count, position);
+            }
+            const Entry &entry = table_[window >> (64 - kTableBits)];
+            if (entry.count_ > 0 && i + 4 <= count) { //Room for the 4 bytes, only count_ of them are kept.
+                memcpy(out + i, &entry.symbols_, 4);
+                i += entry.count_;
+                position += entry.bits_;
+                continue;
+            }
+            unsigned char symbol = 0; //Near the end, or a code longer than kTableBits.
+            uint8_t bits = decodeOne(window, 64, symbol);
+            if (bits == 0) break;
+            out[i++] = char(symbol);
+            position += bits;
         }
-        return extractMax(maxHeap);
+        reader.skip(position - reader.position());
+        return i == count;
     }
+};
+
+/**
+ * Small decoder of canonical Huffman codes, one symbol per call.
+ *
+ * Cheap to build (a 256-entry table for the codes up to 8 bits, the canonical limits for the longer ones), for
+ * the coders that switch tables at every symbol (see ContextHuffman) and can't use the groups of HuffmanDecoder.
+ */
+class HuffmanSymbolDecoder {
+private:
+    static constexpr unsigned kTableBits = 8; /// Bits resolved by a single table load.
+    uint16_t table_[1u << kTableBits] = {}; /// Byte | length << 8 of every prefix (length 0 = a longer code).
+    uint64_t first_[65] = {}; /// First canonical code of every length.
+    uint32_t count_[65] = {}; /// Number of codes of every length.
+    uint32_t offset_[65] = {}; /// Position in symbols_ of the first code of every length.
+    unsigned char symbols_[256] = {}; /// The bytes, sorted by (length, byte).
+    uint8_t max_length_ = 0; /// The longest code.
+
+public:
     /**
-     * Given a root (iterative function) translate the position to a vector of 1's and 0's to encode the Huffman Tree.
-     * @param root The Node of the tree (root)
-     * @param arr The last array (= vector of 1's and 0's)
-     * @param top The Position (Top) starting with 0.
+     * Constructor.
+     * @param length The length of the code of every byte (0 = the byte has no code), at most 64.
      */
-    void translation(struct HuffmanNode *root, int arr[], int top){
-        if (root->left) {
-            arr[top] = 0;
-            translation(root->left, arr, top + 1);
+    explicit HuffmanSymbolDecoder(const uint8_t length[256]) {
+        uint64_t code[256] = {};
+        canonicalCodes(length, code);
+        for (int c = 0; c < 256; c++) {
+            if (length[c] > 0 && length[c] <= 64) count_[length[c]]++;
         }
-        if (root->right) {
-            arr[top] = 1;
-            translation(root->right, arr, top + 1);
+        for (unsigned bits = 1; bits <= 64; bits++) {
+            offset_[bits] = offset_[bits - 1] + count_[bits - 1];
+            if (count_[bits] > 0) max_length_ = uint8_t(bits);
         }
-        if (isLeaf(root)) {
-            int n = sizeof(arr) / sizeof(arr[0]) + 1;
-            std::vector<int> vecint;
-            for (int i = 0; i < top; ++i) {
-                vecint.push_back(arr[i]);
+        uint32_t position[65];
+        memcpy(position, offset_, sizeof(position));
+        for (int c = 0; c < 256; c++) { //Bytes in order, the same order as the canonical codes.
+            uint8_t bits = length[c];
+            if (bits == 0 || bits > 64) continue;
+            if (position[bits] == offset_[bits]) first_[bits] = code[c];
+            symbols_[position[bits]++] = static_cast<unsigned char>(c);
+            if (bits <= kTableBits) {
+                uint32_t from = uint32_t(code[c] << (kTableBits - bits)), to = from + (1u << (kTableBits - bits));
+                for (uint32_t prefix = from; prefix < to; prefix++) table_[prefix] = uint16_t(c | bits << 8);
             }
-            std::vector<int> dest(arr, arr + n);
-            this->freq_map.emplace(root->char_code_, vecint);
         }
     }
-public:
-    /// Getter
-    const std::map<char, std::vector<int>> &getFreqMap() const {
-        return freq_map;
-    }
-    ///To print the encoding results in the terminal.
-    void printCodes(){
-        for (auto &x : this->freq_map){
-            std::string output_string;
-            for (auto &y : x.second){
-                output_string += std::to_string(y);
+    /**
+     * Decodes the code at the top of the window.
+     * @param window The next 64 bits of the stream, left aligned.
+     * @param symbol [out] The byte.
+     * @return The length of the code (0 if there's no code there).
+     */
+    uint8_t decode(uint64_t window, unsigned char &symbol) const {
+        uint16_t entry = table_[window >> (64 - kTableBits)];
+        if (entry >> 8 != 0) {
+            symbol = static_cast<unsigned char>(entry);
+            return uint8_t(entry >> 8);
+        }
+        uint64_t code = window >> (64 - kTableBits);
+        for (uint8_t bits = kTableBits + 1; bits <= max_length_; bits++) {
+            code = (code << 1) | ((window >> (64 - bits)) & 1);
+            if (code - first_[bits] < count_[bits]) {
+                symbol = symbols_[offset_[bits] + (code - first_[bits])];
+                return bits;
             }
-            std::cout << x.first << " : " << output_string << std::endl;
         }
-    }
-    ///The Main Function that receives the frequency tables and do the encoding.
-    void huffmanEncoder(char codes[], int freqs[], int size){
-        struct HuffmanNode *root = buildHuffman(codes, freqs, size);
-        int top = 0;
-        int arr[100];
-        translation(root, arr, top);
-        printCodes();
+        return 0;
     }
 };
 
-
 #endif //FASTA_BASIC_TEXT_FILE_MANAGER_HUFFMAN_H
@@ -0,0 +1,426 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_IOPIPELINE_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_IOPIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define FASTA_HAS_POSIX_IO 1
+#else
+#include <fstream>
+#endif
+
+namespace FastaFile {
+    constexpr size_t kIoChunkSize = size_t(4) << 20; /// Bytes per read or write.
+    constexpr size_t kIoDepth = 4; /// Buffers in flight between the I/O thread and the CPU stage.
+
+    /**
+     * Bounded lock-free queue for a single producer and a single consumer.
+     *
+     * The producer only writes tail_ and the consumer only writes head_, so a release store and an acquire load
+     * on each side are enough; they live on different cache lines so the two threads don't fight over them.
+     */
+    template<typename T>
+    class SpscQueue {
+    private:
+        std::vector<T> slots_; /// The ring (power of two).
+        size_t mask_; /// slots_.size() - 1.
+        alignas(64) std::atomic<size_t> head_{0}; /// Next slot to pop (written by the consumer).
+        alignas(64) std::atomic<size_t> tail_{0}; /// Next slot to push (written by the producer).
+
+    public:
+        /**
+         * Builds an empty queue.
+         * @param capacity Minimum number of slots.
+         */
+        explicit SpscQueue(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) size *= 2;
+            slots_.resize(size);
+            mask_ = size - 1;
+        }
+        /**
+         * Pushes a value (producer only).
+         * @return FALSE if the queue is full (the value is not moved).
+         */
+        bool tryPush(T &value) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == slots_.size()) return false;
+            slots_[tail & mask_] = std::move(value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+        /**
+         * Pops a value (consumer only).
+         * @return FALSE if the queue is empty.
+         */
+        bool tryPop(T &value) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire)) return false;
+            value = std::move(slots_[head & mask_]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    /// Waits a little longer every time: yields first, then sleeps (a stage waiting for the disk burns no CPU).
+    inline void backOff(unsigned &spins) {
+        if (++spins < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    /**
+     * A file read or written from start to end by the I/O thread of a pipeline: pread / pwrite where the platform
+     * has them, a std::fstream otherwise (the pipelines see the same calls).
+     */
+    class IoFile {
+    private:
+#ifdef FASTA_HAS_POSIX_IO
+        int fd_ = -1; /// The file.
+        uint64_t offset_ = 0; /// Next byte to read or write.
+#else
+        std::fstream stream_; /// The file.
+#endif
+
+    public:
+        IoFile() = default;
+        IoFile(const IoFile &) = delete;
+        IoFile &operator=(const IoFile &) = delete;
+        /// Destructor, closes the file.
+        ~IoFile() {
+            close();
+        }
+        /**
+         * Opens a file to read it.
+         * @param file_name The file.
+         * @return FALSE if it can't be opened.
+         */
+        bool openRead(const std::string &file_name) {
+#ifdef FASTA_HAS_POSIX_IO
+            fd_ = ::open(file_name.c_str(), O_RDONLY);
+#ifdef POSIX_FADV_SEQUENTIAL
+            if (fd_ >= 0) posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL); //Bigger kernel read-ahead too.
+#endif
+#else
+            stream_.open(file_name, std::ios::in | std::ios::binary);
+#endif
+            return isOpen();
+        }
+        /**
+         * Creates (or truncates) a file to write it.
+         * @param file_name The file.
+         * @return FALSE if it can't be created.
+         */
+        bool openWrite(const std::string &file_name) {
+#ifdef FASTA_HAS_POSIX_IO
+            fd_ = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#else
+            stream_.open(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+#endif
+            return isOpen();
+        }
+        /// TRUE if the file is open.
+        bool isOpen() const {
+#ifdef FASTA_HAS_POSIX_IO
+            return fd_ >= 0;
+#else
+            return stream_.is_open();
+#endif
+        }
+        /**
+         * Reads the next bytes (it may read less than asked).
+         * @return The bytes read, 0 at the end of the file, -1 if the read failed.
+         */
+        int64_t read(char *data, size_t size) {
+#ifdef FASTA_HAS_POSIX_IO
+            while (true) {
+                ssize_t got = pread(fd_, data, size, off_t(offset_));
+                if (got < 0 && errno == EINTR) continue;
+                if (got > 0) offset_ += uint64_t(got);
+                return int64_t(got);
+            }
+#else
+            stream_.read(data, std::streamsize(size));
+            if (stream_.bad()) return -1;
+            return int64_t(stream_.gcount());
+#endif
+        }
+        /**
+         * Writes the next bytes (it may write less than asked).
+         * @return The bytes written, or -1 if the write failed.
+         */
+        int64_t write(const char *data, size_t size) {
+#ifdef FASTA_HAS_POSIX_IO
+            while (true) {
+                ssize_t put = pwrite(fd_, data, size, off_t(offset_));
+                if (put < 0 && errno == EINTR) continue;
+                if (put > 0) offset_ += uint64_t(put);
+                return int64_t(put);
+            }
+#else
+            stream_.write(data, std::streamsize(size));
+            return stream_.good() ? int64_t(size) : -1;
+#endif
+        }
+        /**
+         * Closes the file.
+         * @return FALSE if it failed (the last bytes written may be lost).
+         */
+        bool close() {
+            if (!isOpen()) return true;
+#ifdef FASTA_HAS_POSIX_IO
+            bool closed = ::close(fd_) == 0;
+            fd_ = -1;
+            return closed;
+#else
+            stream_.close();
+            return !stream_.fail();
+#endif
+        }
+    };
+
+    /// A buffer travelling between the I/O thread and the CPU stage.
+    struct IoBuffer {
+        std::vector<char> bytes_; /// The memory (its size is the capacity).
+        size_t used_ = 0; /// Bytes of data.
+        bool last_ = false; /// TRUE for the end-of-stream marker.
+    };
+
+    /**
+     * Read-ahead stage: a thread reads the file in big chunks (see IoFile) while the caller parses the previous ones.
+     *
+     * Filled buffers go to the caller through one SPSC queue and come back through another one, so only kIoDepth
+     * chunks are ever allocated.
+     */
+    class InputPipeline {
+    private:
+        IoFile file_; /// The file.
+        SpscQueue<IoBuffer> filled_; /// Read thread -> caller.
+        SpscQueue<IoBuffer> free_; /// Caller -> read thread.
+        std::atomic<bool> stop_{false}; /// TRUE when the caller doesn't want more data.
+        std::atomic<bool> failed_{false}; /// TRUE if a read failed.
+        std::thread thread_; /// The read thread.
+        bool done_ = false; /// TRUE once the last chunk was taken.
+
+        /// The loop of the read thread.
+        void readLoop(size_t chunk_size) {
+            IoBuffer buffer;
+            while (!stop_) {
+                unsigned spins = 0;
+                while (!free_.tryPop(buffer)) {
+                    if (stop_) return;
+                    backOff(spins);
+                }
+                buffer.bytes_.resize(chunk_size);
+                buffer.used_ = 0;
+                while (buffer.used_ < chunk_size) { //Short reads are retried until the chunk is full or EOF.
+                    int64_t got = file_.read(buffer.bytes_.data() + buffer.used_, chunk_size - buffer.used_);
+                    if (got < 0) failed_ = true;
+                    if (got <= 0) break;
+                    buffer.used_ += size_t(got);
+                }
+                buffer.last_ = buffer.used_ < chunk_size;
+                spins = 0;
+                while (!filled_.tryPush(buffer)) {
+                    if (stop_) return;
+                    backOff(spins);
+                }
+                if (buffer.last_) return;
+            }
+        }
+
+    public:
+        /**
+         * Opens the file and starts reading ahead.
+         * @param file_name The file.
+         * @param chunk_size Bytes per read.
+         * @param depth Chunks read ahead.
+         */
+        explicit InputPipeline(const std::string &file_name, size_t chunk_size = kIoChunkSize,
+                               size_t depth = kIoDepth) : filled_(depth), free_(depth) {
+            if (!file_.openRead(file_name)) return;
+            for (size_t i = 0; i < depth; i++) {
+                IoBuffer buffer;
+                free_.tryPush(buffer);
+            }
+            thread_ = std::thread([this, chunk_size] { readLoop(chunk_size); });
+        }
+        InputPipeline(const InputPipeline &) = delete;
+        InputPipeline &operator=(const InputPipeline &) = delete;
+        /// Destructor, stops the read thread (the file closes itself).
+        ~InputPipeline() {
+            stop_ = true;
+            if (thread_.joinable()) thread_.join();
+        }
+        /// TRUE if the file could be opened.
+        bool good() const {
+            return file_.isOpen();
+        }
+        /// TRUE if a read failed.
+        bool failed() const {
+            return failed_;
+        }
+        /**
+         * Takes the next chunk, waiting for the read thread if needed. Give it back with release().
+         * @param buffer [out] The chunk (the last one has last_ set, and may be empty).
+         * @return FALSE once the last chunk was taken.
+         */
+        bool next(IoBuffer &buffer) {
+            if (!file_.isOpen() || done_) return false;
+            unsigned spins = 0;
+            while (!filled_.tryPop(buffer)) backOff(spins);
+            done_ = buffer.last_;
+            return true;
+        }
+        /**
+         * Gives a chunk back to the read thread.
+         * @param buffer The chunk.
+         */
+        void release(IoBuffer &buffer) {
+            if (!buffer.bytes_.empty()) free_.tryPush(buffer); //There is always room, the buffers are counted.
+        }
+    };
+
+    /**
+     * Write-behind stage: the caller fills big buffers and a thread writes them (see IoFile) while the next ones are
+     * being filled, so the caller never waits for a small write (nor flushes line by line).
+     */
+    class OutputPipeline {
+    private:
+        IoFile file_; /// The file.
+        size_t chunk_size_; /// Bytes per write.
+        SpscQueue<IoBuffer> filled_; /// Caller -> write thread.
+        SpscQueue<IoBuffer> free_; /// Write thread -> caller.
+        std::atomic<bool> failed_{false}; /// TRUE if a write failed.
+        std::thread thread_; /// The write thread.
+        IoBuffer current_; /// Buffer being filled.
+        bool closed_ = false; /// TRUE after close().
+        uint64_t position_ = 0; /// Bytes appended so far.
+
+        /// The loop of the write thread.
+        void writeLoop() {
+            IoBuffer buffer;
+            while (true) {
+                unsigned spins = 0;
+                while (!filled_.tryPop(buffer)) backOff(spins);
+                if (buffer.last_) return;
+                size_t written = 0;
+                while (written < buffer.used_ && !failed_) { //Short writes are retried.
+                    int64_t put = file_.write(buffer.bytes_.data() + written, buffer.used_ - written);
+                    if (put <= 0) {
+                        failed_ = true;
+                        break;
+                    }
+                    written += size_t(put);
+                }
+                buffer.used_ = 0;
+                free_.tryPush(buffer); //There is always room, the buffers are counted.
+            }
+        }
+        /// Hands the current buffer to the write thread and takes a free one.
+        void submit() {
+            unsigned spins = 0;
+            while (!filled_.tryPush(current_)) backOff(spins);
+            spins = 0;
+            while (!free_.tryPop(current_)) backOff(spins);
+            current_.bytes_.resize(chunk_size_);
+            current_.used_ = 0;
+        }
+
+    public:
+        /**
+         * Creates (or truncates) the file and starts the write thread.
+         * @param file_name The file.
+         * @param chunk_size Bytes per write.
+         * @param depth Chunks in flight.
+         */
+        explicit OutputPipeline(const std::string &file_name, size_t chunk_size = kIoChunkSize,
+                                size_t depth = kIoDepth)
+                : chunk_size_(chunk_size), filled_(depth + 1), free_(depth + 1) {
+            if (!file_.openWrite(file_name)) return;
+            for (size_t i = 1; i < depth; i++) { //current_ is one of them.
+                IoBuffer buffer;
+                buffer.bytes_.resize(chunk_size_);
+                free_.tryPush(buffer);
+            }
+            current_.bytes_.resize(chunk_size_);
+            thread_ = std::thread([this] { writeLoop(); });
+        }
+        OutputPipeline(const OutputPipeline &) = delete;
+        OutputPipeline &operator=(const OutputPipeline &) = delete;
+        /// Destructor, writes what is left.
+        ~OutputPipeline() {
+            close();
+        }
+        /// TRUE if the file could be created and nothing failed so far.
+        bool good() const {
+            return file_.isOpen() && !failed_;
+        }
+        /**
+         * Appends bytes.
+         * @param data The first byte.
+         * @param size Number of bytes.
+         */
+        void write(const char *data, size_t size) {
+            if (!file_.isOpen() || closed_) return;
+            position_ += size;
+            while (size > 0) {
+                size_t taken = std::min(size, chunk_size_ - current_.used_);
+                memcpy(current_.bytes_.data() + current_.used_, data, taken);
+                current_.used_ += taken;
+                data += taken;
+                size -= taken;
+                if (current_.used_ == chunk_size_) submit();
+            }
+        }
+        /// Appends a char.
+        void put(char c) {
+            if (!file_.isOpen() || closed_) return;
+            if (current_.used_ == chunk_size_) submit();
+            current_.bytes_[current_.used_++] = c;
+            position_++;
+        }
+        /// Bytes appended so far (the offset in the file of the next byte).
+        uint64_t position() const {
+            return position_;
+        }
+        /**
+         * Writes what is left, stops the write thread and closes the file.
+         * @return FALSE if something could not be written.
+         */
+        bool close() {
+            if (!file_.isOpen() && !closed_) return false;
+            if (!closed_) {
+                closed_ = true;
+                if (current_.used_ > 0) submit();
+                current_.last_ = true;
+                unsigned spins = 0;
+                while (!filled_.tryPush(current_)) backOff(spins);
+                thread_.join();
+                if (!file_.close()) failed_ = true;
+            }
+            return !failed_;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_IOPIPELINE_H
@@ -0,0 +1,181 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_LAZYSEQUENCES_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_LAZYSEQUENCES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "MappedFile.h"
+#include "Sequence.h"
+
+namespace FastaFile {
+    /**
+     * Finds the first '>' at or after from that starts a line.
+     * @param from Where the search starts.
+     * @param data The start of the buffer (a '>' there starts a line).
+     * @param file_end One past the last char of the buffer.
+     * @return The '>', or nullptr if there's none.
+     */
+    inline const char *nextHeader(const char *from, const char *data, const char *file_end) {
+        for (const char *cursor = from; cursor < file_end; cursor++) {
+            cursor = static_cast<const char *>(memchr(cursor, '>', size_t(file_end - cursor)));
+            if (cursor == nullptr) return nullptr;
+            if (cursor == data || cursor[-1] == '\n') return cursor;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Reads the DNA Lines of a record (the lines after its '>' line) the way the FASTAFile loader does: they run
+     * until a '>' line, an empty line or the end, and only the lines made of valid bases are added.
+     * @param cursor First char after the '>' line.
+     * @param file_end One past the last char of the buffer.
+     * @param sequence [in/out] The Sequence that gets the lines.
+     * @param has_lines [out] TRUE if at least one line was added.
+     * @return Where the record ends (its last line-break + 1, or beyond file_end).
+     */
+    inline const char *readDnaLines(const char *cursor, const char *file_end, DNA_sequence::Sequence &sequence,
+                                    bool &has_lines) {
+        has_lines = false;
+        while (cursor < file_end) {
+            auto line_end = static_cast<const char *>(memchr(cursor, '\n', size_t(file_end - cursor)));
+            if (line_end == nullptr) line_end = file_end; //The last line may not have a line-break.
+            if (line_end == cursor || *cursor == '>') break; //It's not a DNA line, the Sequence is over.
+            if (sequence.addLine(std::string_view(cursor, size_t(line_end - cursor)))) has_lines = true;
+            cursor = line_end + 1;
+        }
+        return cursor;
+    }
+
+    /**
+     * The Sequences of a .fa File, parsed on demand.
+     *
+     * Opening the File only scans it for the '>' lines (memchr over the mapped File) and records where every
+     * record starts and ends. A Sequence is parsed the first time it's asked for and kept in a least recently used
+     * cache of a fixed number of Sequences, every one in its own arena (sized to its record), so evicting it frees its
+     * residues. The
+     * pointers handed out keep their Sequence alive after an eviction.
+     */
+    class LazySequences {
+    private:
+        /// Where a record is in the File.
+        struct Record {
+            std::string name_; /// The name (rest of the '>' line).
+            uint64_t begin_; /// First byte after the '>' line.
+            uint64_t end_; /// The next '>' line, or the end of the File.
+        };
+        using Cached = std::pair<std::shared_ptr<DNA_sequence::Sequence>, std::list<size_t>::iterator>;
+        MappedFile file_; /// The .fa File.
+        const DNA_sequence::BaseAlphabet *alphabet_; /// The valid bases.
+        size_t capacity_; /// Maximum number of resident Sequences.
+        std::vector<Record> records_; /// Every record, in File order.
+        std::list<size_t> recent_; /// Resident records, most recently used first.
+        std::unordered_map<size_t, Cached> resident_; /// The resident Sequences.
+        uint64_t loads_ = 0; /// Sequences parsed so far.
+        std::mutex mutex_; /// Guards the cache.
+
+    public:
+        /**
+         * Maps the File and finds every record.
+         * @param file_name The .fa File.
+         * @param alphabet The valid bases.
+         * @param capacity Maximum number of resident Sequences (at least 1).
+         */
+        LazySequences(const std::string &file_name, const DNA_sequence::BaseAlphabet &alphabet, size_t capacity)
+                : file_(file_name, false), alphabet_(&alphabet), capacity_(std::max<size_t>(capacity, 1)) {
+            if (!file_.good()) return;
+            const char *data = file_.data(), *file_end = file_.end();
+            const char *header = nextHeader(data, data, file_end);
+            while (header != nullptr) {
+                auto line_end = static_cast<const char *>(memchr(header, '\n', size_t(file_end - header)));
+                if (line_end == nullptr) line_end = file_end;
+                const char *next = nextHeader(line_end, data, file_end);
+                records_.push_back({std::string(header + 1, line_end),
+                                    std::min<uint64_t>(uint64_t(line_end - data) + 1, file_.size()),
+                                    next == nullptr ? uint64_t(file_.size()) : uint64_t(next - data)});
+                header = next;
+            }
+        }
+        LazySequences(const LazySequences &) = delete;
+        LazySequences &operator=(const LazySequences &) = delete;
+        /// TRUE if the File could be opened.
+        bool good() const {
+            return file_.good();
+        }
+        /// Number of records (a record without valid DNA Lines gives an empty Sequence).
+        size_t size() const {
+            return records_.size();
+        }
+        /// Name of a record.
+        const std::string &name(size_t index) const {
+            return records_[index].name_;
+        }
+        /// Bytes of the File.
+        size_t fileSize() const {
+            return file_.size();
+        }
+        /**
+         * Finds a record by name: the whole name, or its first word.
+         * @return The position of the record, or -1.
+         */
+        long find(const std::string &name) const {
+            for (size_t i = 0; i < records_.size(); i++) {
+                const std::string &full = records_[i].name_;
+                if (full == name || full.substr(0, full.find_first_of(" \t\r")) == name) return long(i);
+            }
+            return -1;
+        }
+        /**
+         * The Sequence of a record, parsed now if it's not resident (the least recently used one may be evicted).
+         * @param index The position of the record.
+         * @return The Sequence.
+         */
+        std::shared_ptr<DNA_sequence::Sequence> get(size_t index) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto found = resident_.find(index);
+            if (found != resident_.end()) {
+                recent_.splice(recent_.begin(), recent_, found->second.second);
+                return found->second.first;
+            }
+            const Record &record = records_[index];
+            auto arena = std::make_shared<DNA_sequence::SequenceArena>(size_t(record.end_ - record.begin_) + 1);
+            auto sequence = std::make_shared<DNA_sequence::Sequence>(record.name_, *alphabet_, arena);
+            sequence->reserveResidues(size_t(record.end_ - record.begin_)); //The record is an upper bound.
+            bool has_lines;
+            readDnaLines(file_.data() + record.begin_, file_.data() + record.end_, *sequence, has_lines);
+            sequence->releaseSpareResidues();
+            loads_++;
+            if (resident_.size() >= capacity_) {
+                resident_.erase(recent_.back());
+                recent_.pop_back();
+            }
+            recent_.push_front(index);
+            resident_.emplace(index, Cached(sequence, recent_.begin()));
+            return sequence;
+        }
+        /// Number of resident Sequences.
+        size_t resident() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return resident_.size();
+        }
+        /// Sequences parsed so far (a Sequence evicted and asked for again counts twice).
+        uint64_t loads() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return loads_;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_LAZYSEQUENCES_H
@@ -0,0 +1,114 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_MAPPEDFILE_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_MAPPEDFILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FASTA_HAS_MMAP 1
+#endif
+
+namespace FastaFile {
+    /**
+     * Read-only view of an entire file.
+     *
+     * The file is memory-mapped when the platform allows it, so the parser can scan the whole buffer once with
+     * memchr instead of streaming it line by line. If mmap is not available (or fails, e.g. on a pipe) the file is
+     * read into a single heap buffer instead, the view is the same for the caller.
+     */
+    class MappedFile {
+    private:
+        const char *data_ = nullptr; /// First byte of the file.
+        size_t size_ = 0; /// Size of the file in bytes.
+        bool good_ = false; /// TRUE if the file could be opened.
+        bool mapped_ = false; /// TRUE if data_ points to a mmap region (must be unmapped).
+        std::vector<char> fallback_; /// Heap copy of the file when mmap is not used.
+
+        /// Reads the whole file into fallback_.
+        void readFallback(const std::string &file_name) {
+            std::ifstream input(file_name, std::ios::in | std::ios::binary);
+            if (!input.good()) return;
+            input.seekg(0, std::ios::end);
+            std::streamoff length = input.tellg();
+            input.seekg(0, std::ios::beg);
+            if (length > 0) {
+                fallback_.resize(size_t(length));
+                input.read(fallback_.data(), length);
+            }
+            data_ = fallback_.data();
+            size_ = fallback_.size();
+            good_ = true;
+        }
+
+    public:
+        /// Default Constructor, an empty (not good) view.
+        MappedFile() = default;
+        /**
+         * Opens and maps the given file.
+         * @param file_name The path of the file.
+         * @param sequential FALSE if the file will be read at random places (no read-ahead hint).
+         */
+        explicit MappedFile(const std::string &file_name, bool sequential = true) {
+#ifdef FASTA_HAS_MMAP
+            int fd = ::open(file_name.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                struct stat info{};
+                if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+                    size_ = size_t(info.st_size);
+                    good_ = true;
+                    if (size_ > 0) {
+                        void *region = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                        if (region != MAP_FAILED) {
+                            ::madvise(region, size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                            data_ = static_cast<const char *>(region);
+                            mapped_ = true;
+                        } else {
+                            good_ = false;
+                        }
+                    }
+                }
+                ::close(fd);
+                if (good_) return;
+            }
+#endif
+            readFallback(file_name);
+        }
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        /// Destructor, releases the mapping.
+        ~MappedFile() {
+#ifdef FASTA_HAS_MMAP
+            if (mapped_) ::munmap(const_cast<char *>(data_), size_);
+#endif
+        }
+        /// TRUE if the file was opened.
+        bool good() const {
+            return good_;
+        }
+        /// First byte of the file.
+        const char *data() const {
+            return data_;
+        }
+        /// One past the last byte of the file.
+        const char *end() const {
+            return data_ + size_;
+        }
+        /// Size in bytes.
+        size_t size() const {
+            return size_;
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_MAPPEDFILE_H
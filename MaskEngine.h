@@ -0,0 +1,172 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_MASKENGINE_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_MASKENGINE_H
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Sequence.h"
+
+namespace FastaFile {
+    /**
+     * Maps base offsets (line-breaks don't count) to positions in the residues buffer of a Sequence.
+     *
+     * Only CRLF files keep a '\r' inside the buffer, for every other file the map is the identity and costs nothing.
+     */
+    class ResidueMap {
+    private:
+        std::vector<size_t> positions_; /// Buffer position of every base, only when the buffer has '\r'.
+        size_t bases_ = 0; /// Number of bases.
+        bool identity_ = true; /// TRUE if base offset == buffer position.
+    public:
+        /**
+         * Builds the map.
+         * @param residues The residues buffer.
+         * @param skip_cr FALSE to keep the '\r' as bases (when the '\r' itself is being masked).
+         */
+        explicit ResidueMap(std::string_view residues, bool skip_cr = true) {
+            identity_ = !skip_cr || memchr(residues.data(), '\r', residues.size()) == nullptr;
+            if (identity_) {
+                bases_ = residues.size();
+                return;
+            }
+            positions_.reserve(residues.size());
+            for (size_t i = 0; i < residues.size(); i++) {
+                if (residues[i] != '\r') positions_.push_back(i);
+            }
+            bases_ = positions_.size();
+        }
+        /// Buffer position of the base.
+        size_t operator[](size_t base) const {
+            return identity_ ? base : positions_[base];
+        }
+        /// Number of bases.
+        size_t size() const {
+            return bases_;
+        }
+    };
+
+    /**
+     * A masking pattern compiled once, literal or with IUPAC codes.
+     *
+     * Every position of the pattern is a set of accepted bases. By default the pattern is literal and case-sensitive:
+     * every position accepts its exact byte. With iupac, an IUPAC code accepts the bases it stands for (R = A/G,
+     * N = anything...) and letters match regardless of case, so soft-masked (lowercase) regions are found too.
+     * Patterns of up to 64 bases are matched with the bit-parallel Shift-And algorithm, one table load and two bit
+     * operations per base; longer ones are checked position by position.
+     */
+    class MaskPattern {
+    private:
+        size_t length_ = 0; /// Bases of the pattern.
+        std::array<uint64_t, 256> shift_and_{}; /// Bit i of shift_and_[c] is set if position i accepts c.
+        std::vector<std::array<bool, 256>> accepts_; /// Accepted bases per position (long patterns).
+
+        /// Bases an IUPAC code stands for (the code itself if it's not one).
+        static std::string expand(char code) {
+            switch (toupper(static_cast<unsigned char>(code))) {
+                case 'R': return "AGR";
+                case 'Y': return "CTUY";
+                case 'S': return "GCS";
+                case 'W': return "ATUW";
+                case 'K': return "GTUK";
+                case 'M': return "ACM";
+                case 'B': return "CGTUB";
+                case 'D': return "AGTUD";
+                case 'H': return "ACTUH";
+                case 'V': return "ACGV";
+                case 'N': return "ACGTURYSWKMBDHVN";
+                default: return std::string(1, code);
+            }
+        }
+
+    public:
+        /**
+         * Compiles the pattern.
+         * @param pattern The subsequence, IUPAC codes allowed.
+         * @param iupac TRUE to expand the IUPAC codes and ignore case, FALSE to match the exact bytes.
+         */
+        explicit MaskPattern(const std::string &pattern, bool iupac = false) : length_(pattern.size()) {
+            accepts_.resize(length_);
+            for (size_t i = 0; i < length_; i++) {
+                for (char base: iupac ? expand(pattern[i]) : std::string(1, pattern[i])) {
+                    auto lower = static_cast<unsigned char>(iupac ? tolower(static_cast<unsigned char>(base)) : base);
+                    auto upper = static_cast<unsigned char>(iupac ? toupper(static_cast<unsigned char>(base)) : base);
+                    accepts_[i][lower] = accepts_[i][upper] = true;
+                    if (i < 64) {
+                        shift_and_[lower] |= uint64_t(1) << i;
+                        shift_and_[upper] |= uint64_t(1) << i;
+                    }
+                }
+            }
+        }
+        /// Bases of the pattern.
+        size_t length() const {
+            return length_;
+        }
+        /**
+         * Finds every (also overlapping) match in the bases of a Sequence.
+         * @param residues The residues buffer.
+         * @param map The base offsets of the buffer.
+         * @param found Called with the base offset of the first base of every match.
+         */
+        template<typename Callback>
+        void findAll(std::string_view residues, const ResidueMap &map, Callback &&found) const {
+            if (length_ == 0 || map.size() < length_) return;
+            if (length_ <= 64) {
+                const uint64_t accept = uint64_t(1) << (length_ - 1);
+                uint64_t state = 0;
+                for (size_t base = 0; base < map.size(); base++) {
+                    state = ((state << 1) | 1) & shift_and_[static_cast<unsigned char>(residues[map[base]])];
+                    if (state & accept) found(base + 1 - length_);
+                }
+                return;
+            }
+            for (size_t base = 0; base + length_ <= map.size(); base++) {
+                size_t i = 0;
+                while (i < length_ && accepts_[i][static_cast<unsigned char>(residues[map[base + i]])]) i++;
+                if (i == length_) found(base);
+            }
+        }
+    };
+
+    /// An interval of a BED file, [start, end) in base offsets of the named Sequence.
+    struct MaskInterval {
+        std::string sequence_; /// First word of the Sequence name.
+        size_t start_; /// First base.
+        size_t end_; /// One past the last base.
+    };
+
+    /**
+     * Reads the intervals of a BED-like file (chrom, start, end separated by whitespace, 0-based half open).
+     * Comment, "track" and "browser" lines are skipped.
+     * @param bed_file The file.
+     * @param intervals [out] The intervals.
+     * @return FALSE if the file can't be opened.
+     */
+    inline bool readBedFile(const std::string &bed_file, std::vector<MaskInterval> &intervals) {
+        std::ifstream input(bed_file);
+        if (!input.good()) return false;
+        std::string line;
+        while (getline(input, line)) {
+            if (line.empty() || line[0] == '#' || line.rfind("track", 0) == 0 || line.rfind("browser", 0) == 0) continue;
+            std::istringstream fields(line);
+            MaskInterval interval;
+            if (fields >> interval.sequence_ >> interval.start_ >> interval.end_ && interval.start_ < interval.end_) {
+                intervals.push_back(interval);
+            }
+        }
+        return true;
+    }
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_MASKENGINE_H
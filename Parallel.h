@@ -0,0 +1,236 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_PARALLEL_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FastaFile {
+    /// Number of hardware threads of the machine.
+    inline unsigned hardwareThreads() {
+        unsigned threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : threads;
+    }
+
+    /// The --threads setting (0 = not set).
+    inline std::atomic<unsigned> &threadsSetting() {
+        static std::atomic<unsigned> setting{0};
+        return setting;
+    }
+
+    /**
+     * Sets the number of threads used when the caller doesn't ask for a specific amount (the --threads knob).
+     * @param threads Number of threads (0 = every hardware thread).
+     */
+    inline void setDefaultThreads(unsigned threads) {
+        threadsSetting() = threads;
+    }
+
+    /// Number of threads to use when the caller doesn't ask for a specific amount.
+    inline unsigned defaultThreads() {
+        unsigned setting = threadsSetting();
+        return setting == 0 ? hardwareThreads() : setting;
+    }
+
+    /**
+     * Work-stealing thread pool.
+     *
+     * Every worker has its own task queue: it takes its own tasks from the back (the most recent, still hot in
+     * its cache) and, when it runs out, steals from the front of the other queues, so a worker stuck with a big
+     * task doesn't hold back the ones queued behind it. Tasks submitted from outside the pool are spread over the
+     * queues round-robin. A thread waiting for its tasks runs queued tasks meanwhile (see helpUntil), so nested
+     * parallel loops can't deadlock. The workers, and the waiting threads, sleep when there's nothing to do.
+     */
+    class ThreadPool {
+    public:
+        using Task = std::function<void()>; /// A task.
+
+    private:
+        /// The queue of a worker.
+        struct Queue {
+            std::mutex mutex_; /// Guards tasks_.
+            std::deque<Task> tasks_; /// The tasks.
+        };
+        std::vector<std::unique_ptr<Queue>> queues_; /// One per worker.
+        std::vector<std::thread> workers_; /// The workers.
+        std::mutex sleep_mutex_; /// Guards the sleep of the workers.
+        std::condition_variable wake_; /// Wakes the workers up.
+        std::condition_variable progress_; /// Wakes helpUntil up: a task finished or was queued.
+        std::atomic<size_t> pending_{0}; /// Tasks queued and not taken yet.
+        std::atomic<size_t> next_queue_{0}; /// Round-robin for the tasks submitted from outside.
+        bool stop_ = false; /// TRUE when the pool is being destroyed.
+
+        /// Position of the calling thread in its pool (-1 if it's not a worker).
+        static long &workerIndex() {
+            static thread_local long index = -1;
+            return index;
+        }
+        /// The pool of the calling thread (nullptr if it's not a worker).
+        static const ThreadPool *&workerPool() {
+            static thread_local const ThreadPool *pool = nullptr;
+            return pool;
+        }
+        /// Takes a task: from the back of the own queue, or stolen from the front of another one.
+        bool take(size_t own, Task &task) {
+            size_t count = queues_.size();
+            for (size_t k = 0; k < count; k++) {
+                Queue &queue = *queues_[(own + k) % count];
+                std::lock_guard<std::mutex> lock(queue.mutex_);
+                if (queue.tasks_.empty()) continue;
+                if (k == 0) {
+                    task = std::move(queue.tasks_.back());
+                    queue.tasks_.pop_back();
+                } else {
+                    task = std::move(queue.tasks_.front());
+                    queue.tasks_.pop_front();
+                }
+                pending_--;
+                return true;
+            }
+            return false;
+        }
+        /// Tells the threads in helpUntil that a task finished (their condition may hold now).
+        void taskFinished() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_); //No waiting thread can miss it.
+            }
+            progress_.notify_all();
+        }
+        /// The loop of every worker.
+        void workerLoop(size_t index) {
+            workerIndex() = long(index);
+            workerPool() = this;
+            Task task;
+            while (true) {
+                if (take(index, task)) {
+                    task();
+                    task = nullptr;
+                    taskFinished();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                wake_.wait(lock, [this] { return stop_ || pending_ > 0; });
+                if (stop_ && pending_ == 0) return;
+            }
+        }
+
+    public:
+        /**
+         * Starts the workers.
+         * @param threads Number of workers (at least 1).
+         */
+        explicit ThreadPool(unsigned threads) {
+            threads = std::max(threads, 1u);
+            for (unsigned i = 0; i < threads; i++) queues_.push_back(std::make_unique<Queue>());
+            for (unsigned i = 0; i < threads; i++) workers_.emplace_back([this, i] { workerLoop(i); });
+        }
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        /// Destructor, runs the queued tasks and joins the workers.
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto &worker: workers_) worker.join();
+        }
+        /// The pool shared by the whole program, sized for the machine (or the --threads knob, if bigger).
+        static ThreadPool &shared() {
+            static ThreadPool pool(std::max(hardwareThreads(), defaultThreads()) - 1); //The caller works too.
+            return pool;
+        }
+        /// Number of workers.
+        unsigned size() const {
+            return unsigned(workers_.size());
+        }
+        /**
+         * Queues a task.
+         * @param task The task.
+         */
+        void submit(Task task) {
+            size_t queue = workerPool() == this ? size_t(workerIndex()) : next_queue_++ % queues_.size();
+            {
+                std::lock_guard<std::mutex> lock(queues_[queue]->mutex_);
+                queues_[queue]->tasks_.push_back(std::move(task));
+            }
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_); //No worker can miss the wake up.
+                pending_++;
+            }
+            wake_.notify_one();
+            progress_.notify_all(); //A thread in helpUntil may take it.
+        }
+        /**
+         * Runs queued tasks until the condition holds. When there's nothing left to take it sleeps until a task
+         * finishes (or another one is queued), so it doesn't spin for the length of the longest task.
+         * @param done The condition, it must become TRUE inside a task of this pool.
+         */
+        template<typename Condition>
+        void helpUntil(Condition &&done) {
+            size_t own = workerPool() == this ? size_t(workerIndex()) : next_queue_++ % queues_.size();
+            Task task;
+            while (!done()) {
+                if (take(own, task)) {
+                    task();
+                    task = nullptr;
+                    taskFinished();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                progress_.wait(lock, [&] { return pending_ > 0 || done(); });
+            }
+        }
+    };
+
+    /**
+     * Runs body(index, worker) for every index in [0, count) across several threads of the shared pool.
+     *
+     * Indexes are handed out one at a time from a shared counter, so uneven tasks (a big chromosome next to many
+     * small contigs) still balance. worker is in [0, threads) and lets the body keep per-thread state (like a
+     * sub-histogram) without locking. The caller works too, as worker 0. With a single thread (or a single task)
+     * everything runs in the caller.
+     * @param count Number of tasks.
+     * @param body The task, called as body(size_t index, unsigned worker).
+     * @param threads Number of threads (0 = defaultThreads()).
+     * @return The number of workers really used.
+     */
+    template<typename Body>
+    unsigned parallelFor(size_t count, Body &&body, unsigned threads = 0) {
+        if (threads == 0) threads = defaultThreads();
+        ThreadPool &pool = ThreadPool::shared();
+        threads = unsigned(std::min<size_t>(std::min<size_t>(threads, count), size_t(pool.size()) + 1));
+        if (threads <= 1) {
+            for (size_t i = 0; i < count; i++) body(i, 0u);
+            return 1;
+        }
+        std::atomic<size_t> next{0};
+        std::atomic<unsigned> finished{0};
+        auto worker_loop = [&](unsigned worker) {
+            for (size_t i = next++; i < count; i = next++) body(i, worker);
+        };
+        for (unsigned w = 1; w < threads; w++) {
+            pool.submit([&worker_loop, &finished, w] {
+                worker_loop(w);
+                finished++;
+            });
+        }
+        worker_loop(0);
+        pool.helpUntil([&] { return finished == threads - 1; });
+        return threads;
+    }
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_PARALLEL_H
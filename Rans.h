@@ -0,0 +1,198 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_RANS_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_RANS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Interleaved rANS (range asymmetric numeral systems) coder with a static order-0 table.
+ *
+ * Unlike Huffman it spends fractional bits: a base with probability p costs -log2(p) bits, so the rare IUPAC
+ * codes next to A/C/G/T don't round the common bases up to whole bits. The frequencies are scaled to 2^12 and
+ * eight states (64 bits each, renormalized 32 bits at a time) take the bases in turn, so the eight chains of the
+ * decoder are independent and run in parallel in the CPU. Every base is decoded with one table lookup, one
+ * multiply and, about once every 16 bases of a state, one 32-bit read.
+ *
+ * Payload: the table (uint16 count of symbols, then (byte, uint16 frequency) pairs), the eight final states and
+ * the 32-bit words, in the order the decoder reads them.
+ */
+class RansCodec {
+public:
+    static constexpr unsigned kScaleBits = 12; /// The frequencies add up to 2^kScaleBits.
+    static constexpr uint32_t kScale = uint32_t(1) << kScaleBits; /// Sum of the frequencies.
+    static constexpr unsigned kStates = 8; /// Interleaved states.
+    static constexpr uint64_t kLowerBound = uint64_t(1) << 31; /// The states stay in [2^31, 2^63).
+
+    /**
+     * Scales a histogram so it adds up to kScale, keeping at least 1 for every byte present.
+     * @param frequency Occurrences of every byte.
+     * @param normalized [out] The scaled frequencies (all zero if the histogram is empty).
+     */
+    static void normalize(const uint64_t frequency[256], uint16_t normalized[256]) {
+        uint64_t total = 0;
+        for (int c = 0; c < 256; c++) total += frequency[c];
+        std::fill(normalized, normalized + 256, uint16_t(0));
+        if (total == 0) return;
+        uint32_t sum = 0;
+        int largest = 0;
+        for (int c = 0; c < 256; c++) {
+            if (frequency[c] == 0) continue;
+            auto scaled = uint32_t((frequency[c] * kScale + total / 2) / total);
+            normalized[c] = uint16_t(std::max<uint32_t>(scaled, 1));
+            sum += normalized[c];
+            if (normalized[c] > normalized[largest]) largest = c;
+        }
+        while (sum > kScale) { //The rare bytes raised to 1 took too much: take it back from the largest ones.
+            normalized[largest]--;
+            sum--;
+            for (int c = 0; c < 256; c++) if (normalized[c] > normalized[largest]) largest = c;
+        }
+        normalized[largest] += uint16_t(kScale - sum);
+    }
+    /**
+     * Encodes the bases.
+     * @param residues The bases.
+     * @param frequency Occurrences of every byte in the bases.
+     * @param payload [out] The encoded bases are appended.
+     */
+    static void encode(std::string_view residues, const uint64_t frequency[256], std::string &payload) {
+        uint16_t normalized[256];
+        normalize(frequency, normalized);
+        uint32_t cumulative[256];
+        uint16_t symbols = 0;
+        for (int c = 0, sum = 0; c < 256; c++) {
+            cumulative[c] = uint32_t(sum);
+            sum += normalized[c];
+            symbols += normalized[c] > 0;
+        }
+        appendRaw(payload, symbols);
+        for (int c = 0; c < 256; c++) {
+            if (normalized[c] == 0) continue;
+            payload.push_back(char(c));
+            appendRaw(payload, normalized[c]);
+        }
+        std::vector<uint32_t> words; //Written backwards, the decoder reads them forwards.
+        words.reserve(residues.size() / 12 + 16);
+        uint64_t state[kStates];
+        std::fill(state, state + kStates, kLowerBound);
+        for (size_t i = residues.size(); i-- > 0;) {
+            auto base = static_cast<unsigned char>(residues[i]);
+            uint64_t &x = state[i % kStates];
+            uint32_t f = normalized[base];
+            if (x >= (uint64_t(f) << (63 - kScaleBits))) { //Would leave [2^31, 2^63) after the step.
+                words.push_back(uint32_t(x));
+                x >>= 32;
+            }
+            uint64_t quotient = x / f;
+            x = (quotient << kScaleBits) + (x - quotient * f) + cumulative[base];
+        }
+        for (uint64_t x: state) appendRaw(payload, x);
+        std::reverse(words.begin(), words.end());
+        payload.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint32_t));
+    }
+    /**
+     * Decodes the bases written by encode.
+     * @param payload The encoded bases.
+     * @param size Bytes of the payload.
+     * @param out [out] The bases.
+     * @param count Number of bases.
+     * @return FALSE if the payload is not valid.
+     */
+    static bool decode(const char *payload, size_t size, char *out, size_t count) {
+        const char *cursor = payload, *end = payload + size;
+        uint16_t symbols;
+        if (!readRaw(cursor, end, symbols) || symbols > 256) return false;
+        std::vector<uint32_t> slots(kScale); //Per slot: the byte, its frequency - 1 and the slot - cumulative.
+        uint32_t sum = 0;
+        for (uint16_t i = 0; i < symbols; i++) {
+            uint8_t byte;
+            uint16_t f;
+            if (!readRaw(cursor, end, byte) || !readRaw(cursor, end, f) || f == 0 || sum + f > kScale) return false;
+            for (uint32_t slot = 0; slot < f; slot++) slots[sum + slot] = byte | uint32_t(f - 1) << 8 | slot << 20;
+            sum += f;
+        }
+        if (sum != kScale && count > 0) return false;
+        uint64_t state[kStates];
+        for (uint64_t &x: state) {
+            if (!readRaw(cursor, end, x) || x < kLowerBound) return false;
+        }
+        const size_t words_count = size_t(end - cursor) / sizeof(uint32_t);
+        const uint32_t *table = slots.data();
+        size_t next = 0, i = 0;
+        uint64_t x0 = state[0], x1 = state[1], x2 = state[2], x3 = state[3]; //Kept in registers.
+        uint64_t x4 = state[4], x5 = state[5], x6 = state[6], x7 = state[7];
+        for (; i + kStates <= count && next + kStates <= words_count; i += kStates) { //Can't run out of words.
+            out[i] = step(table, x0, cursor, next);
+            out[i + 1] = step(table, x1, cursor, next);
+            out[i + 2] = step(table, x2, cursor, next);
+            out[i + 3] = step(table, x3, cursor, next);
+            out[i + 4] = step(table, x4, cursor, next);
+            out[i + 5] = step(table, x5, cursor, next);
+            out[i + 6] = step(table, x6, cursor, next);
+            out[i + 7] = step(table, x7, cursor, next);
+        }
+        state[0] = x0, state[1] = x1, state[2] = x2, state[3] = x3;
+        state[4] = x4, state[5] = x5, state[6] = x6, state[7] = x7;
+        for (; i < count; i++) {
+            uint64_t &x = state[i % kStates];
+            if (next == words_count) { //Only a state that doesn't need a word can go on.
+                uint32_t entry = table[x & (kScale - 1)];
+                x = uint64_t((entry >> 8 & 0xfff) + 1) * (x >> kScaleBits) + (entry >> 20);
+                if (x < kLowerBound) return false;
+                out[i] = char(entry & 0xff);
+            } else {
+                out[i] = step(table, x, cursor, next);
+            }
+        }
+        for (uint64_t x: state) {
+            if (x != kLowerBound) return false; //The encoder started from kLowerBound.
+        }
+        return next == words_count;
+    }
+
+private:
+    /**
+     * Decodes a base and renormalizes its state. A branch, not a conditional move: the other states go on while
+     * the word is read, and it's rarely taken.
+     * @param table The slots built by decode.
+     * @param x The state.
+     * @param words The 32-bit words.
+     * @param next [in, out] The next word, words[next] must exist.
+     * @return The base.
+     */
+    static char step(const uint32_t *table, uint64_t &x, const char *words, size_t &next) {
+        uint32_t entry = table[x & (kScale - 1)];
+        x = uint64_t((entry >> 8 & 0xfff) + 1) * (x >> kScaleBits) + (entry >> 20);
+        if (x < kLowerBound) {
+            uint32_t word;
+            memcpy(&word, words + next * sizeof(uint32_t), sizeof(uint32_t));
+            x = x << 32 | word;
+            next++;
+        }
+        return char(entry & 0xff);
+    }
+    /// Appends the bytes of a value.
+    template<typename T>
+    static void appendRaw(std::string &payload, const T &value) {
+        payload.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+    /// Reads a value and moves the cursor, FALSE if it goes past the end.
+    template<typename T>
+    static bool readRaw(const char *&cursor, const char *end, T &value) {
+        if (size_t(end - cursor) < sizeof(T)) return false;
+        memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+};
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_RANS_H
@@ -0,0 +1,62 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_REGION_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_REGION_H
+
+#include <cstdint>
+#include <string>
+
+namespace FastaFile {
+    /// A region of a Sequence, 1-based and inclusive (samtools style).
+    struct Region {
+        std::string name_; /// The Sequence.
+        uint64_t start_ = 1; /// First base.
+        uint64_t end_ = UINT64_MAX; /// Last base (UINT64_MAX = up to the end).
+    };
+
+    /**
+     * Reads a whole positive number of a region.
+     * @param text The number (digits only).
+     * @param value [out] The number.
+     * @return FALSE if the text is empty, has anything but digits or doesn't fit in 64 bits.
+     */
+    inline bool parseRegionNumber(const std::string &text, uint64_t &value) {
+        value = 0;
+        if (text.empty()) return false;
+        for (char c: text) {
+            if (c < '0' || c > '9' || value > (UINT64_MAX - uint64_t(c - '0')) / 10) return false;
+            value = value * 10 + uint64_t(c - '0');
+        }
+        return true;
+    }
+
+    /**
+     * Reads "name", "name:start", "name:start-" (up to the end) or "name:start-end" (',' allowed in the numbers,
+     * e.g. chr7:1,000,000-1,001,000).
+     * @param text The region.
+     * @param whole_name TRUE to take the whole text as the name (for names that contain a ':').
+     * @return The region (start_ is 0 if a number is not valid).
+     */
+    inline Region parseRegion(const std::string &text, bool whole_name = false) {
+        Region region;
+        size_t colon = whole_name ? std::string::npos : text.rfind(':');
+        region.name_ = text.substr(0, colon);
+        if (colon == std::string::npos) return region;
+        std::string numbers;
+        for (char c: text.substr(colon + 1)) {
+            if (c != ',') numbers.push_back(c);
+        }
+        size_t dash = numbers.find('-');
+        bool valid = parseRegionNumber(numbers.substr(0, dash), region.start_);
+        if (dash != std::string::npos && dash + 1 < numbers.size()) { //An empty end goes up to the end.
+            valid = valid && parseRegionNumber(numbers.substr(dash + 1), region.end_);
+        }
+        if (!valid) region.start_ = 0;
+        return region;
+    }
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_REGION_H
@@ -0,0 +1,104 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_RUNLENGTH_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_RUNLENGTH_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TwoBitCodec.h"
+
+/**
+ * Run-length pre-pass of the entropy codecs: long runs of the same byte (the N runs of scaffolds, the X runs left
+ * by maskFile, the '-' gaps of alignments) are taken out of the residues into a run list, and only the rest is
+ * entropy coded. A run of any length costs a few bytes instead of a code per base, and the decoder refills it
+ * with memset.
+ */
+class RunLength {
+public:
+    static constexpr size_t kMinRun = 32; /// Shorter runs are left to the entropy coder.
+
+    /**
+     * Finds the long runs of the residues.
+     * @param residues The residues.
+     * @param runs [out] The runs of kMinRun or more equal bytes, in order.
+     */
+    static void find(std::string_view residues, std::vector<BaseRun> &runs) {
+        runs.clear();
+        const char *data = residues.data();
+        const size_t size = residues.size();
+        for (size_t i = 0; i < size;) {
+            const char base = data[i];
+            size_t j = i + 1;
+            if (j + 8 <= size && data[j] == base) { //A run, compare 8 bytes at a time.
+                uint64_t pattern = uint64_t(0x0101010101010101) * static_cast<unsigned char>(base), word;
+                while (j + 8 <= size && (memcpy(&word, data + j, 8), word == pattern)) j += 8;
+            }
+            while (j < size && data[j] == base) j++;
+            if (j - i >= kMinRun) runs.push_back({i, j - i, base});
+            i = j;
+        }
+    }
+    /**
+     * Takes the long runs out of the residues.
+     * @param residues The residues.
+     * @param runs [out] The runs (see find).
+     * @param rest [out] The other bytes, in order (only filled if there are runs).
+     * @return The bytes left to the entropy coder: residues itself if there are no runs, else rest.
+     */
+    static std::string_view split(std::string_view residues, std::vector<BaseRun> &runs, std::string &rest) {
+        find(residues, runs);
+        rest.clear();
+        if (runs.empty()) return residues;
+        uint64_t run_bytes = 0;
+        for (const BaseRun &run: runs) run_bytes += run.length_;
+        rest.reserve(residues.size() - run_bytes);
+        size_t position = 0;
+        for (const BaseRun &run: runs) {
+            rest.append(residues.data() + position, run.start_ - position);
+            position = run.start_ + run.length_;
+        }
+        rest.append(residues.data() + position, residues.size() - position);
+        return rest;
+    }
+    /**
+     * Puts the runs back, in place.
+     * @param out [in, out] size bytes, the rest of split from out + (bytes in runs), the residues on return.
+     * @param size Bytes of the residues.
+     * @param runs The runs (in order, inside the residues, they are validated by the caller).
+     */
+    static void expand(char *out, size_t size, const std::vector<BaseRun> &runs) {
+        uint64_t run_bytes = 0;
+        for (const BaseRun &run: runs) run_bytes += run.length_;
+        const char *literal = out + run_bytes; //The rest, always at or after the position it moves to.
+        size_t position = 0;
+        for (const BaseRun &run: runs) {
+            size_t literal_size = run.start_ - position;
+            memmove(out + position, literal, literal_size);
+            literal += literal_size;
+            memset(out + run.start_, run.base_, run.length_);
+            position = run.start_ + run.length_;
+        }
+        memmove(out + position, literal, size - position);
+    }
+    /**
+     * TRUE if the runs are in order, don't overlap and fit in the residues.
+     * @param runs The runs.
+     * @param size Bytes of the residues.
+     */
+    static bool valid(const std::vector<BaseRun> &runs, size_t size) {
+        uint64_t position = 0;
+        for (const BaseRun &run: runs) {
+            if (run.start_ < position || run.length_ > size || run.start_ > size - run.length_) return false;
+            position = run.start_ + run.length_;
+        }
+        return true;
+    }
+};
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_RUNLENGTH_H
@@ -6,6 +6,8 @@
 #define FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCE_H
 
 #include <iostream>
+#include <bitset>
+#include <iterator>
 #include <list>
 #include <utility>
 #include <regex>
@@ -16,29 +18,101 @@
 #include <vector>
 #include <iomanip>
 #include <math.h>
+#include <memory>
+#include <string_view>
+#include "BaseAlphabet.h"
+#include "SequenceArena.h"
 
 namespace DNA_sequence {
+    /**
+     * Read-only view of the DNA Lines of a Sequence.
+     *
+     * Iterating it yields one std::string_view per line, pointing straight into the residues buffer of the
+     * Sequence, so nothing is copied. The view is valid until the Sequence is modified.
+     */
+    class LinesView {
+    private:
+        const char *residues_; /// The residues buffer of the Sequence.
+        const std::vector<size_t> *line_ends_; /// End offset of every line in the buffer.
+    public:
+        /// Iterator over the lines.
+        class iterator {
+        private:
+            const char *residues_;
+            const std::vector<size_t> *line_ends_;
+            size_t index_;
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string_view *;
+            using reference = std::string_view;
+            iterator(const char *residues, const std::vector<size_t> *line_ends, size_t index)
+                    : residues_(residues), line_ends_(line_ends), index_(index) {}
+            std::string_view operator*() const {
+                size_t begin = index_ == 0 ? 0 : (*line_ends_)[index_ - 1];
+                return {residues_ + begin, (*line_ends_)[index_] - begin};
+            }
+            iterator &operator++() {
+                ++index_;
+                return *this;
+            }
+            iterator operator++(int) {
+                iterator old = *this;
+                ++index_;
+                return old;
+            }
+            bool operator==(const iterator &other) const {
+                return index_ == other.index_;
+            }
+            bool operator!=(const iterator &other) const {
+                return index_ != other.index_;
+            }
+        };
+        LinesView(const char *residues, const std::vector<size_t> *line_ends)
+                : residues_(residues), line_ends_(line_ends) {}
+        iterator begin() const {
+            return {residues_, line_ends_, 0};
+        }
+        iterator end() const {
+            return {residues_, line_ends_, line_ends_->size()};
+        }
+        /// Number of lines.
+        size_t size() const {
+            return line_ends_->size();
+        }
+        /// The line in the given position.
+        std::string_view operator[](size_t index) const {
+            return *iterator(residues_, line_ends_, index);
+        }
+    };
+
     /**
      * Implementation of the Sequence Data Structure.
      *
-     * The Data Structure Sequence contains the Entire DNA Sequence using a list of Strings. Those Strings has the
-     * complete line of DNA like: 'ATTGGTAATTAAGGGATTATGATAGAT'
+     * The Data Structure Sequence contains the Entire DNA Sequence in a single contiguous buffer of residues
+     * (allocated from the SequenceArena of its File), plus the end offset of every line, so the original lines like
+     * 'ATTGGTAATTAAGGGATTATGATAGAT' can still be reproduced through linesList().
      * Also have the name (not unique) for the Sequence, and a bool that says if the sequence is correct (Doesn't
      * contain any not recognized DNA Base).
      *
      */
     class Sequence {
     public:
-        std::list<std::string> lines_list_;  /// A list of Strings, each String is a DNA Line.
+        std::shared_ptr<SequenceArena> arena_; /// The arena that owns the residues buffer.
+        char *residues_ = nullptr; /// Every DNA Base of the Sequence, line after line.
+        size_t residues_size_ = 0; /// Number of bases in residues_.
+        size_t residues_capacity_ = 0; /// Size of the block of residues_ in the arena.
+        std::vector<size_t> line_ends_; /// End offset (in residues_) of every DNA Line.
         std::string seq_name_; /// The name of the entire Sequence.
         bool seq_correct_bool_ = true; /// TRUE if the sequence has only correct DNA bases.
-        int max_len_line_ = 0; /// Indentation of the Sequence, is the max length of any string in the lines_list_
+        int64_t max_len_line_ = 0; /// Indentation of the Sequence, is the max length of any DNA Line.
         bool complete_ = true; /// TRUE if the sequence doesn't contain any "-" that indicates incomplete lines.
         std::vector<std::vector<std::vector<int>>> matrix_;
-        int x_matrix_size_ = max_len_line_;
-        int y_matrix_size_ = lines_list_.size();
+        int x_matrix_size_ = 0;
+        int y_matrix_size_ = 0;
         std::vector<std::vector<std::vector<int>>> tile_matrix_;
-        std::list<char> valids_;
+        const BaseAlphabet *alphabet_ = &BaseAlphabet::get(AlphabetKind::Default); /// The valid DNA Bases.
         /**
         * Default Constructor.
         */
@@ -46,37 +120,91 @@ namespace DNA_sequence {
         /**
         * The constructor of the Sequence.
         * @param nombre_secuencia The name for the DNA Sequence.
+        * @param alphabet The valid DNA Bases (shared, never copied).
+        * @param arena The arena of the File, where the residues will be allocated.
         * @overload
         */
-        explicit Sequence(const std::string &sequence_name, std::list<char> valids) {
+        explicit Sequence(const std::string &sequence_name, const BaseAlphabet &alphabet,
+                          std::shared_ptr<SequenceArena> arena = nullptr) {
             this->seq_name_ = sequence_name;
-            this->valids_ = valids;
+            this->alphabet_ = &alphabet;
+            this->arena_ = std::move(arena);
         }
-        /// Destructor for the class
-        ~Sequence() {
-            this->lines_list_.clear();
-            this->seq_name_.clear();
+        /**
+        * Copy Constructor, the copy gets its own residues (in an arena of its own), so masking one of them
+        * doesn't change the other.
+        * @param obj The Sequence to copy.
+        */
+        Sequence(const Sequence &obj)
+                : Sequence(obj, std::make_shared<SequenceArena>(std::max<size_t>(obj.residues_size_, 1))) {}
+        /**
+        * Copies a Sequence, with its residues, into the given arena (e.g. the one of the File that gets the copy).
+        * @param obj The Sequence to copy.
+        * @param arena The arena of the copy.
+        */
+        Sequence(const Sequence &obj, const std::shared_ptr<SequenceArena> &arena)
+                : residues_(obj.residues_), residues_size_(obj.residues_size_), line_ends_(obj.line_ends_),
+                  seq_name_(obj.seq_name_), seq_correct_bool_(obj.seq_correct_bool_),
+                  max_len_line_(obj.max_len_line_), complete_(obj.complete_), matrix_(obj.matrix_),
+                  x_matrix_size_(obj.x_matrix_size_), y_matrix_size_(obj.y_matrix_size_),
+                  tile_matrix_(obj.tile_matrix_), alphabet_(obj.alphabet_) {
+            rehome(arena);
+        }
+        /// Copy assignment, a deep copy (see the Copy Constructor).
+        Sequence &operator=(const Sequence &obj) {
+            if (this != &obj) *this = Sequence(obj);
+            return *this;
+        }
+        /**
+        * Move Constructor, takes the residues, the DNA Lines and the name without allocating anything.
+        * @param obj The Sequence to move, left empty.
+        */
+        Sequence(Sequence &&obj) noexcept {
+            *this = std::move(obj);
+        }
+        /**
+        * Move assignment, takes the residues, the DNA Lines and the name without allocating anything.
+        * @param obj The Sequence to move, left empty.
+        */
+        Sequence &operator=(Sequence &&obj) noexcept {
+            if (this == &obj) return *this;
+            this->arena_ = std::move(obj.arena_);
+            this->residues_ = std::exchange(obj.residues_, nullptr);
+            this->residues_size_ = std::exchange(obj.residues_size_, 0);
+            this->residues_capacity_ = std::exchange(obj.residues_capacity_, 0);
+            this->line_ends_ = std::move(obj.line_ends_);
+            this->seq_name_ = std::move(obj.seq_name_);
+            this->seq_correct_bool_ = obj.seq_correct_bool_;
+            this->max_len_line_ = std::exchange(obj.max_len_line_, 0);
+            this->complete_ = obj.complete_;
+            this->matrix_ = std::move(obj.matrix_);
+            this->x_matrix_size_ = std::exchange(obj.x_matrix_size_, 0);
+            this->y_matrix_size_ = std::exchange(obj.y_matrix_size_, 0);
+            this->tile_matrix_ = std::move(obj.tile_matrix_);
+            this->alphabet_ = obj.alphabet_;
+            return *this;
         }
+        /// Destructor for the class
+        ~Sequence() = default;
         /**
-        * Add the given string to the lines_list_ of the Sequence.
+        * Add the given string to the DNA Lines of the Sequence.
         *
+        * Soft-masked (lowercase) bases are valid too and are kept as they are, like the streaming compressor does.
         * @param line Is a String that represent a DNA Line.
         * @return TRUE if the DNA Line contain only valid DNA Bases.
         */
-        bool addLine(std::string line) {
-            int temp_max = int(line.length()); /// Temporary new max_len_line.
+        bool addLine(std::string_view line) {
+            int64_t temp_max = int64_t(line.length()); /// Temporary new max_len_line.
             bool success = false; /// Check if the line is correct.
-            std::string::const_iterator it = line.begin();
-            while (it != line.end() && checkBase(*it)) {
-                ++it;
-            }
-            if (!line.empty() && it == line.end()) {
-                lines_list_.push_back(line);
+            size_t valid = alphabet_->validPrefix(line.data(), line.size());
+            if (!line.empty() && (valid == line.size() ||
+                                  alphabet_->validFolded(line.data() + valid, line.size() - valid))) {
+                appendResidues(line);
                 success = true;
             }
             if (temp_max > this->max_len_line_) this->max_len_line_ = temp_max;
-            x_matrix_size_ = max_len_line_;
-            y_matrix_size_ = lines_list_.size();
+            x_matrix_size_ = int(max_len_line_);
+            y_matrix_size_ = int(line_ends_.size());
             return success;
         }
         /**
@@ -93,9 +221,8 @@ namespace DNA_sequence {
         * @param c The char to valid
         * @return TRUE if the char is valid.
         */
-        bool checkBase(char c) {
-            bool found = (std::find(valids_.begin(), valids_.end(), c) != valids_.end());
-            return found;
+        bool checkBase(char c) const {
+            return alphabet_->valid(c);
         }
         /// Getter for the Sequence Correct Bool.
         bool sequenceCorrect() const {
@@ -103,7 +230,8 @@ namespace DNA_sequence {
         }
         /// Forced Destructor.
         void clear() {
-            this->lines_list_.clear();
+            this->residues_size_ = 0;
+            this->line_ends_.clear();
             this->seq_name_.clear();
         }
 
@@ -124,35 +252,131 @@ namespace DNA_sequence {
             return this->seq_name_;
         }
         /**
-        * List of DNA Lines Getter
-        * @return The List of Strings with DNA Lines
+        * DNA Lines Getter
+        * @return A view of the DNA Lines, no line is copied.
+        */
+        LinesView linesList() const {
+            return {this->residues_, &this->line_ends_};
+        }
+        /**
+        * Every DNA Base of the Sequence as a single contiguous buffer.
+        * @return A view of the residues buffer.
+        */
+        std::string_view residues() const {
+            return {this->residues_, this->residues_size_};
+        }
+        /**
+        * Writable access to the residues buffer, to modify bases in place (the line layout is not modified).
+        * @return The first base of the buffer.
         */
-        std::list<std::string> linesList() {
-            return this->lines_list_;
+        char *mutableResidues() {
+            return this->residues_;
         }
         /**
         * List of DNA Lines Setter
         * @param new_list The new List of Strings
         */
-        void updateSeqLinesList(std::list<std::string> new_list) {
-            this->lines_list_ = std::move(new_list);
+        void updateSeqLinesList(const std::list<std::string> &new_list) {
+            this->residues_size_ = 0;
+            this->residues_capacity_ = 0; // The old block stays in the arena until it dies.
+            this->residues_ = nullptr;
+            this->line_ends_.clear();
+            for (const auto &line: new_list) {
+                appendResidues(line);
+            }
+            y_matrix_size_ = int(line_ends_.size());
+        }
+        /**
+        * Reserves the residues buffer before the DNA Lines are added, so it's allocated once and never moved.
+        * Only for a Sequence without residues yet; give back what was not used with releaseSpareResidues().
+        * @param capacity Bytes to reserve (e.g. the size of the record in the File, an upper bound).
+        */
+        void reserveResidues(size_t capacity) {
+            if (this->residues_size_ > 0 || capacity <= this->residues_capacity_) return;
+            if (!this->arena_) this->arena_ = std::make_shared<SequenceArena>();
+            this->residues_ = this->arena_->allocate(capacity);
+            this->residues_capacity_ = capacity;
+        }
+        /**
+        * Gives the unused end of the residues buffer back to the arena (if nothing was allocated after it).
+        */
+        void releaseSpareResidues() {
+            if (this->arena_) this->arena_->shrink(this->residues_, this->residues_size_, this->residues_capacity_);
+        }
+        /**
+        * Replaces every DNA Line of the Sequence at once (a single allocation).
+        * @param residues Every base, line after line.
+        * @param line_lengths The length of every line, they must add up to residues.size().
+        */
+        template<typename Length>
+        void assignLines(std::string_view residues, const std::vector<Length> &line_lengths) {
+            char *buffer = allocateLines(residues.size(), line_lengths);
+            if (!residues.empty()) memcpy(buffer, residues.data(), residues.size());
+        }
+        /**
+        * Replaces every DNA Line of the Sequence by a buffer the caller fills in (e.g. a decoder, in parallel).
+        * @param size Bytes of residues.
+        * @param line_lengths The length of every line, they must add up to size.
+        * @return The residues buffer, size bytes to be written.
+        */
+        template<typename Length>
+        char *allocateLines(size_t size, const std::vector<Length> &line_lengths) {
+            if (!this->arena_) this->arena_ = std::make_shared<SequenceArena>();
+            this->residues_ = this->arena_->allocate(size);
+            this->residues_size_ = size;
+            this->residues_capacity_ = size;
+            this->line_ends_.clear();
+            this->line_ends_.reserve(line_lengths.size());
+            size_t end = 0;
+            for (Length length: line_lengths) {
+                end += size_t(length);
+                this->line_ends_.push_back(std::min(end, size));
+            }
+            y_matrix_size_ = int(line_ends_.size());
+            return this->residues_;
         }
         /**
         * The maximum DNA Line length Getter
         * @return The Max. Length line.
         */
-        int maxLenLine() const {
+        int64_t maxLenLine() const {
             return this->max_len_line_;
         }
         /// Return the amount of Lines inside the DNA Sequence.
-        int identation() {
-            int identation_ = int(lines_list_.size());
+        int identation() const {
+            int identation_ = int(line_ends_.size());
             return identation_;
         }
         /// To update the maximum length line.
-        void updateMaxLenLine(int length) {
+        void updateMaxLenLine(int64_t length) {
             this->max_len_line_ = length;
         }
+        /**
+         * Moves the residues of the Sequence to another arena (used when a File is copied, so both Files can be
+         * modified independently).
+         * @param arena The new arena.
+         */
+        void rehome(const std::shared_ptr<SequenceArena> &arena) {
+            char *block = arena->allocate(this->residues_size_);
+            if (this->residues_size_ > 0) memcpy(block, this->residues_, this->residues_size_);
+            this->residues_ = block;
+            this->residues_capacity_ = this->residues_size_;
+            this->arena_ = arena;
+        }
+    private:
+        /**
+         * Appends a DNA Line at the end of the residues buffer.
+         * @param line The DNA Line.
+         */
+        void appendResidues(std::string_view line) {
+            if (!this->arena_) this->arena_ = std::make_shared<SequenceArena>();
+            size_t new_size = this->residues_size_ + line.size();
+            this->residues_ = this->arena_->grow(this->residues_, this->residues_size_, new_size,
+                                                 this->residues_capacity_);
+            if (!line.empty()) memcpy(this->residues_ + this->residues_size_, line.data(), line.size());
+            this->residues_size_ = new_size;
+            this->line_ends_.push_back(new_size);
+        }
     private:
         /**
          * To resize the matrix_.
@@ -207,24 +431,21 @@ namespace DNA_sequence {
          * To transform the Sequence Data Structure into a matrix.
          */
         void makeGraph(){
-            y_matrix_size_ = lines_list_.size();
-            x_matrix_size_ = max_len_line_;
+            LinesView lines = linesList();
+            y_matrix_size_ = int(lines.size());
+            x_matrix_size_ = int(max_len_line_);
             insVertex(y_matrix_size_, x_matrix_size_, matrix_);
             int pos_y = 0;
-            for (auto str_it = lines_list_.begin(); pos_y < lines_list_.size(); str_it++, pos_y++) {
+            for (; pos_y < int(lines.size()); pos_y++) {
                 int pos_x = 0;
                 std::string actual, last, next;
                 std::vector<int> vec_NH(4, -1);
-                actual = *str_it;
-                str_it++;
-                if (str_it != lines_list_.end()) {
-                    next = *str_it;
-                    str_it--;
+                actual = std::string(lines[pos_y]);
+                if (pos_y + 1 < int(lines.size())) {
+                    next = std::string(lines[pos_y + 1]);
                 }
-                if (str_it != lines_list_.begin()) {
-                    str_it--;
-                    last = *str_it;
-                    str_it++;
+                if (pos_y > 0) {
+                    last = std::string(lines[pos_y - 1]);
                 }
                 for (; pos_x < actual.size(); pos_x++) {
                     unsigned char actual_char = actual[pos_x];
@@ -0,0 +1,113 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCEARENA_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace DNA_sequence {
+    /**
+     * Bump allocator for the residues of every Sequence of a single File.
+     *
+     * Memory is handed out from big chunks and is never returned one block at a time, the whole arena is freed in
+     * one shot when the last File (or Sequence) that uses it is destroyed. While a File is being loaded only one
+     * Sequence grows at a time, its buffer is always the last block of the current chunk, so growing it is just
+     * moving the bump pointer (see grow()).
+     */
+    class SequenceArena {
+    private:
+        std::vector<std::unique_ptr<char[]>> chunks_; /// Every chunk allocated so far.
+        size_t chunk_size_; /// Default size of a new chunk.
+        char *cursor_ = nullptr; /// Next free byte in the current chunk.
+        size_t remaining_ = 0; /// Free bytes left in the current chunk.
+        size_t used_ = 0; /// Bytes handed out (for the information printer).
+
+        /// Opens a new chunk with room for at least min_size bytes.
+        void newChunk(size_t min_size) {
+            size_t size = std::max(chunk_size_, min_size);
+            chunks_.emplace_back(new char[size]);
+            cursor_ = chunks_.back().get();
+            remaining_ = size;
+        }
+
+    public:
+        /**
+         * Constructor.
+         * @param chunk_size The default size in bytes of every chunk (1 MB by default).
+         */
+        explicit SequenceArena(size_t chunk_size = size_t(1) << 20) : chunk_size_(chunk_size) {}
+        SequenceArena(const SequenceArena &) = delete;
+        SequenceArena &operator=(const SequenceArena &) = delete;
+        /**
+         * Allocates a block.
+         * @param size Bytes needed.
+         * @return The new block, valid until the arena is destroyed.
+         */
+        char *allocate(size_t size) {
+            if (size > remaining_) newChunk(size);
+            char *block = cursor_;
+            cursor_ += size;
+            remaining_ -= size;
+            used_ += size;
+            return block;
+        }
+        /**
+         * Grows a block to new_size bytes keeping its content.
+         *
+         * If the block is the last one handed out and the chunk has room it's extended in place, otherwise the
+         * content is moved to a new (geometrically bigger) block and the old one stays unused until the arena dies.
+         * @param block The block to grow (nullptr for a new one).
+         * @param old_size The size of the block.
+         * @param new_size The needed size.
+         * @param capacity [in/out] The real size of the block, updated if the block moves or grows.
+         * @return The (maybe moved) block.
+         */
+        char *grow(char *block, size_t old_size, size_t new_size, size_t &capacity) {
+            if (new_size <= capacity) return block;
+            if (block != nullptr && block + capacity == cursor_ && new_size - capacity <= remaining_) {
+                size_t extra = new_size - capacity;
+                cursor_ += extra;
+                remaining_ -= extra;
+                used_ += extra;
+                capacity = new_size;
+                return block;
+            }
+            size_t new_capacity = std::max(new_size, capacity * 2);
+            char *moved = allocate(new_capacity);
+            if (old_size > 0) memcpy(moved, block, old_size);
+            capacity = new_capacity;
+            return moved;
+        }
+        /**
+         * Gives back the unused end of a block, if it's the last one handed out (otherwise nothing changes).
+         * @param block The block.
+         * @param size The bytes of the block that are kept.
+         * @param capacity [in/out] The real size of the block, updated if the end is given back.
+         */
+        void shrink(char *block, size_t size, size_t &capacity) {
+            if (block == nullptr || size >= capacity || block + capacity != cursor_) return;
+            size_t extra = capacity - size;
+            cursor_ -= extra;
+            remaining_ += extra;
+            used_ -= extra;
+            capacity = size;
+        }
+        /// Bytes handed out by the arena.
+        size_t usedBytes() const {
+            return used_;
+        }
+        /// Number of chunks allocated.
+        size_t chunksCount() const {
+            return chunks_.size();
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCEARENA_H
@@ -0,0 +1,294 @@
+/*
+ * This File is part of FASTA_Basic-Text-File-Manager.
+ */
+
+#ifndef FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCESEARCH_H
+#define FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCESEARCH_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Sequence.h"
+
+namespace FastaFile {
+    /// A single match of a search: the Sequence (position in the File) and the offset of the first base.
+    struct SearchMatch {
+        size_t sequence_; /// Index of the Sequence in the sequences list of the File.
+        size_t offset_; /// Offset (in bases, line-breaks don't count) of the match inside the Sequence.
+    };
+
+    /**
+     * Gives the bases of a Sequence as a single string without the '\r' of CRLF lines, so matches can span lines.
+     *
+     * For files with plain '\n' line-breaks (the usual case) the residues buffer is used directly, nothing is
+     * copied.
+     */
+    class SearchText {
+    private:
+        std::string compact_; /// Copy without '\r', only used when the Sequence has them.
+        std::string_view residues_; /// The residues, when they can be used directly.
+        bool compacted_ = false; /// TRUE if compact_ is the text.
+    public:
+        explicit SearchText(const DNA_sequence::Sequence &sequence) {
+            residues_ = sequence.residues();
+            if (memchr(residues_.data(), '\r', residues_.size()) == nullptr) return;
+            compact_.reserve(residues_.size());
+            for (char base: residues_) {
+                if (base != '\r') compact_.push_back(base);
+            }
+            compacted_ = true;
+        }
+        /// The bases to search in.
+        std::string_view text() const {
+            return compacted_ ? std::string_view(compact_) : residues_;
+        }
+    };
+
+    /**
+     * Boyer-Moore-Horspool searcher, for one-off queries.
+     *
+     * The pattern is compiled once (bad-character shift table), then every call to findAll() scans a text in
+     * sub-linear time on average and reports every (also overlapping) occurrence.
+     */
+    class HorspoolSearcher {
+    private:
+        std::string pattern_; /// The pattern.
+        std::array<size_t, 256> shift_{}; /// Shift for every byte under the last position of the window.
+    public:
+        explicit HorspoolSearcher(std::string pattern) : pattern_(std::move(pattern)) {
+            size_t m = pattern_.size();
+            shift_.fill(m);
+            for (size_t i = 0; i + 1 < m; i++) shift_[static_cast<unsigned char>(pattern_[i])] = m - 1 - i;
+        }
+        /**
+         * Finds every occurrence of the pattern.
+         * @param text The text.
+         * @param found Called with the offset of every match.
+         */
+        template<typename Callback>
+        void findAll(std::string_view text, Callback &&found) const {
+            size_t m = pattern_.size();
+            if (m == 0 || text.size() < m) return;
+            const char *data = text.data();
+            const char last = pattern_[m - 1];
+            size_t pos = 0;
+            while (pos <= text.size() - m) {
+                char window_last = data[pos + m - 1];
+                if (window_last == last && memcmp(data + pos, pattern_.data(), m - 1) == 0) found(pos);
+                pos += shift_[static_cast<unsigned char>(window_last)];
+            }
+        }
+    };
+
+    /**
+     * FM-Index of every Sequence of a File.
+     *
+     * Built once per loaded File (suffix array by induced sorting, then the BWT with occurrence checkpoints), it
+     * answers a query of length M with a backward search in O(M) and reports every match in O(occ) more, so
+     * repeated searches from the menu don't scan the File again. Sequences are concatenated with a separator that
+     * never matches, so a match never spans two Sequences.
+     */
+    class FMIndex {
+    private:
+        static constexpr size_t kCheckpoint = 64; /// Positions between occurrence checkpoints.
+        std::array<int, 256> code_{}; /// Compact code of every byte (-1 if the byte is not in the text).
+        int sigma_ = 0; /// Number of codes (0 = end, 1 = separator, 2... = bases).
+        std::vector<uint8_t> bwt_; /// Burrows-Wheeler transform, as codes.
+        std::vector<uint32_t> suffix_array_; /// Position in the text of every sorted suffix.
+        std::vector<uint64_t> first_; /// first_[c] = Number of text positions with a code smaller than c.
+        std::vector<uint32_t> occurrences_; /// Occurrences of every code before every checkpoint.
+        std::vector<size_t> starts_; /// Offset of every Sequence in the text.
+
+        /// Occurrences of the code in bwt_[0, position).
+        uint64_t rank(int code, size_t position) const {
+            size_t block = position / kCheckpoint;
+            uint64_t count = occurrences_[block * sigma_ + code];
+            for (size_t i = block * kCheckpoint; i < position; i++) count += (bwt_[i] == code);
+            return count;
+        }
+
+        static constexpr uint32_t kEmpty = UINT32_MAX; /// Free slot of the suffix array while it is induced.
+
+        /**
+         * Suffix array of the text (whose last code is the unique 0) by induced sorting (SA-IS), in linear time.
+         *
+         * Besides the suffix array only the L/S types and the LMS positions (at most half of the text) are kept, and
+         * long runs (e.g. of N) cost the same as any other text.
+         * @param text The codes of the text (uint8_t at the top level, uint32_t names in the recursion).
+         * @param upper The biggest code of the text.
+         */
+        template<typename Code>
+        static std::vector<uint32_t> suffixArray(const std::vector<Code> &text, uint32_t upper) {
+            uint32_t n = uint32_t(text.size());
+            if (n == 0) return {};
+            if (n == 1) return {0};
+            if (n == 2) return text[0] < text[1] ? std::vector<uint32_t>{0, 1} : std::vector<uint32_t>{1, 0};
+            std::vector<uint32_t> sa(n);
+            std::vector<bool> s_type(n); // TRUE if the suffix is smaller than the next one.
+            for (uint32_t i = n - 1; i-- > 0;) {
+                s_type[i] = text[i] == text[i + 1] ? s_type[i + 1] : text[i] < text[i + 1];
+            }
+            std::vector<uint32_t> sum_l(size_t(upper) + 1, 0), sum_s(size_t(upper) + 1, 0); // Bucket starts.
+            for (uint32_t i = 0; i < n; i++) {
+                if (!s_type[i]) sum_s[text[i]]++;
+                else sum_l[text[i] + 1]++;
+            }
+            for (uint32_t c = 0; c <= upper; c++) {
+                sum_s[c] += sum_l[c];
+                if (c < upper) sum_l[c + 1] += sum_s[c];
+            }
+            std::vector<uint32_t> bucket(size_t(upper) + 1);
+            auto induce = [&](const std::vector<uint32_t> &lms) {
+                std::fill(sa.begin(), sa.end(), kEmpty);
+                std::copy(sum_s.begin(), sum_s.end(), bucket.begin());
+                for (uint32_t position: lms) sa[bucket[text[position]]++] = position;
+                std::copy(sum_l.begin(), sum_l.end(), bucket.begin());
+                sa[bucket[text[n - 1]]++] = n - 1;
+                for (uint32_t i = 0; i < n; i++) { // L-type suffixes, left to right.
+                    uint32_t v = sa[i];
+                    if (v != kEmpty && v >= 1 && !s_type[v - 1]) sa[bucket[text[v - 1]]++] = v - 1;
+                }
+                std::copy(sum_l.begin(), sum_l.end(), bucket.begin());
+                for (uint32_t i = n; i-- > 0;) { // S-type suffixes, right to left.
+                    uint32_t v = sa[i];
+                    if (v != kEmpty && v >= 1 && s_type[v - 1]) sa[--bucket[text[v - 1] + 1]] = v - 1;
+                }
+            };
+            std::vector<uint32_t> lms_index(n, kEmpty); // Rank of every LMS position among the LMS positions.
+            std::vector<uint32_t> lms;
+            for (uint32_t i = 1; i < n; i++) {
+                if (!s_type[i - 1] && s_type[i]) {
+                    lms_index[i] = uint32_t(lms.size());
+                    lms.push_back(i);
+                }
+            }
+            uint32_t m = uint32_t(lms.size());
+            induce(lms);
+            if (m == 0) return sa;
+            std::vector<uint32_t> sorted_lms;
+            sorted_lms.reserve(m);
+            for (uint32_t v: sa) {
+                if (lms_index[v] != kEmpty) sorted_lms.push_back(v);
+            }
+            std::vector<uint32_t> names(m); // The reduced text: the LMS substrings, named by their order.
+            uint32_t name = 0;
+            names[lms_index[sorted_lms[0]]] = 0;
+            for (uint32_t i = 1; i < m; i++) {
+                uint32_t l = sorted_lms[i - 1], r = sorted_lms[i];
+                uint32_t end_l = lms_index[l] + 1 < m ? lms[lms_index[l] + 1] : n;
+                uint32_t end_r = lms_index[r] + 1 < m ? lms[lms_index[r] + 1] : n;
+                bool same = end_l - l == end_r - r;
+                if (same) {
+                    while (l < end_l && text[l] == text[r]) {
+                        l++;
+                        r++;
+                    }
+                    same = l != n && text[l] == text[r];
+                }
+                if (!same) name++;
+                names[lms_index[sorted_lms[i]]] = name;
+            }
+            std::vector<uint32_t>().swap(lms_index); // Not needed by the recursion.
+            std::vector<uint32_t> reduced = suffixArray(names, name);
+            std::vector<uint32_t>().swap(names);
+            for (uint32_t i = 0; i < m; i++) sorted_lms[i] = lms[reduced[i]];
+            induce(sorted_lms);
+            return sa;
+        }
+
+    public:
+        /**
+         * Builds the index.
+         * @param sequences The Sequences of the File.
+         * @return FALSE if the File is too big for the 32-bit index.
+         */
+        bool build(const std::list<DNA_sequence::Sequence> &sequences) {
+            std::vector<SearchText> texts;
+            size_t total = 1;
+            for (const auto &sequence: sequences) {
+                texts.emplace_back(sequence);
+                total += texts.back().text().size() + 1;
+            }
+            if (total >= UINT32_MAX) return false;
+            code_.fill(-1);
+            std::array<bool, 256> present{};
+            for (const auto &text: texts) {
+                for (char base: text.text()) present[static_cast<unsigned char>(base)] = true;
+            }
+            sigma_ = 2;
+            for (int b = 0; b < 256; b++) {
+                if (present[b]) code_[b] = sigma_++;
+            }
+            if (sigma_ > 256) return false; // Codes must fit in a byte.
+            std::vector<uint8_t> text; // Codes of every Sequence + separator, and the final end code.
+            text.reserve(total);
+            starts_.clear();
+            for (const auto &sequence_text: texts) {
+                starts_.push_back(text.size());
+                for (char base: sequence_text.text()) text.push_back(uint8_t(code_[static_cast<unsigned char>(base)]));
+                text.push_back(1);
+            }
+            text.push_back(0);
+            suffix_array_ = suffixArray(text, uint32_t(sigma_ - 1));
+            size_t n = text.size();
+            bwt_.resize(n);
+            first_.assign(sigma_ + 1, 0);
+            occurrences_.assign((n / kCheckpoint + 1) * sigma_, 0);
+            std::vector<uint32_t> running(sigma_, 0);
+            for (size_t i = 0; i < n; i++) {
+                if (i % kCheckpoint == 0) {
+                    std::copy(running.begin(), running.end(), occurrences_.begin() + (i / kCheckpoint) * sigma_);
+                }
+                bwt_[i] = text[(suffix_array_[i] + n - 1) % n];
+                running[bwt_[i]]++;
+            }
+            if (n % kCheckpoint == 0) {
+                std::copy(running.begin(), running.end(), occurrences_.begin() + (n / kCheckpoint) * sigma_);
+            }
+            for (int c = 0; c < sigma_; c++) first_[c + 1] = first_[c] + running[c];
+            return true;
+        }
+        /// TRUE if the index has been built.
+        bool ready() const {
+            return !bwt_.empty();
+        }
+        /**
+         * Finds every occurrence of the pattern.
+         * @param pattern The subsequence to find.
+         * @return The matches, sorted by Sequence and offset.
+         */
+        std::vector<SearchMatch> find(const std::string &pattern) const {
+            std::vector<SearchMatch> matches;
+            if (pattern.empty() || !ready()) return matches;
+            uint64_t low = 0, high = bwt_.size();
+            for (size_t i = pattern.size(); i-- > 0 && low < high;) {
+                int code = code_[static_cast<unsigned char>(pattern[i])];
+                if (code < 0) return matches;
+                low = first_[code] + rank(code, low);
+                high = first_[code] + rank(code, high);
+            }
+            matches.reserve(high - low);
+            for (uint64_t i = low; i < high; i++) {
+                size_t position = suffix_array_[i];
+                size_t sequence = size_t(std::upper_bound(starts_.begin(), starts_.end(), position) - starts_.begin()) - 1;
+                matches.push_back({sequence, position - starts_[sequence]});
+            }
+            std::sort(matches.begin(), matches.end(), [](const SearchMatch &a, const SearchMatch &b) {
+                return a.sequence_ != b.sequence_ ? a.sequence_ < b.sequence_ : a.offset_ < b.offset_;
+            });
+            return matches;
+        }
+        /// Approximate memory used by the index, in bytes.
+        size_t memoryBytes() const {
+            return bwt_.size() + suffix_array_.size() * sizeof(uint32_t) + occurrences_.size() * sizeof(uint32_t);
+        }
+    };
+}
+
+
+#endif //FASTA_BASIC_TEXT_FILE_MANAGER_SEQUENCESEARCH_H
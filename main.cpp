@@ -1,7 +1,74 @@
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
 #include "FastaFile.cpp"
 
-int main() {
+/**
+ * Asks how the bases of a .fabin File are encoded.
+ * @return The codec.
+ */
+static FastaFile::FabinCodec askCodec() {
+    std::cout << "Pack A/C/G/T at 2 bits per base? (y/n, b = Huffman table per block,"
+                 " c = per block and per order-2 context, r = rANS)" << std::endl;
+    char answer = 'n';
+    std::cin >> answer;
+    switch (answer) {
+        case 'y':
+        case 'Y':
+            return FastaFile::FabinCodec::TwoBit;
+        case 'b':
+        case 'B':
+            return FastaFile::FabinCodec::BlockHuffman;
+        case 'c':
+        case 'C':
+            return FastaFile::FabinCodec::ContextHuffman;
+        case 'r':
+        case 'R':
+            return FastaFile::FabinCodec::Rans;
+        default:
+            return FastaFile::FabinCodec::Huffman;
+    }
+}
+
+/**
+ * Parses the value of --threads.
+ * @param text The value.
+ * @param threads [out] The number of threads.
+ * @return FALSE if it's not a whole positive number.
+ */
+static bool parseThreads(const char *text, unsigned &threads) {
+    if (text == nullptr || *text < '0' || *text > '9') return false; //strtoul would take "-1" or " 4".
+    char *end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value == 0 || value > 4096) return false;
+    threads = unsigned(value);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) { // --threads N (or --threads=N): threads used by the parallel steps.
+        std::string argument = argv[i];
+        const char *value = nullptr;
+        if (argument == "--timings") { //Print how fast every File is loaded.
+            FastaFile::timingsSetting() = true;
+            continue;
+        }
+        if (argument == "--threads") {
+            value = i + 1 < argc ? argv[++i] : nullptr;
+        } else if (argument.rfind("--threads=", 0) == 0) {
+            value = argv[i] + 10;
+        } else {
+            continue;
+        }
+        unsigned threads = 0;
+        if (!parseThreads(value, threads)) {
+            std::cout << "Usage: " << argv[0] << " [--threads N] [--timings] (N = number of threads, 1 to 4096)"
+                      << std::endl;
+            return 1;
+        }
+        FastaFile::setDefaultThreads(threads);
+    }
 
     std::cout << "Hello World! Zarzamora  .... " << std::endl;
     std::list<std::string> filenames_list;
@@ -40,6 +107,16 @@ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\
 | 6.    | EXPORT A FASTA FILE AS .FABIN (COMPRESS)                        |
 | 7.    | FIND THE SHORTEST PATH BETWEEN TWO BASES.                       |
 | 8.    | EXIT                                                            |
+| 9.    | BATCH SEARCH OF A PATTERNS FILE IN A FASTA FILE                 |
+| A.    | MASK A FASTA FILE LOADED IN MEMORY (SUBSEQUENCE OR .BED FILE)   |
+| B.    | FETCH A REGION OF A .FABIN OR .FA FILE (E.G. chr7:1,000-2,000)  |
+| C.    | BENCHMARK .FABIN COMPRESSION SCALING WITH THE NUMBER OF THREADS |
+| D.    | STREAM-COMPRESS A .FA FILE TO .FABIN (WITHOUT LOADING IT)       |
+| E.    | STREAM-DECOMPRESS A .FABIN FILE TO .FA (WITHOUT LOADING IT)     |
+| F.    | EXPORT A FASTA FILE RE-WRAPPED (E.G. 60/80) WITH A .FAI INDEX   |
+| G.    | BUILD THE .FAI INDEX OF A .FA FILE (WITHOUT LOADING IT)         |
+| H.    | OPEN A .FA FILE LAZILY (HEADERS NOW, SEQUENCES ON DEMAND)       |
+| I.    | COUNT THE HEAP ALLOCATIONS OF LOADING A .FA FILE                |
 |       |                                                                 |
 +───────+─────────────────────────────────────────────────────────────────+
 
@@ -57,7 +134,7 @@ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\
                 filenames_list.push_back(nombre_temp);
                 FastaFile::FASTAFile ArchivoTemp(nombre_temp, 1);
                 std::cout << "File re-built!" << std::endl;
-                files_mainlist.push_back(ArchivoTemp);
+                files_mainlist.push_back(std::move(ArchivoTemp));
                 std::cout << "File loaded in memory!" << std::endl;
                 break;
             }
@@ -69,16 +146,70 @@ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\
                 std::cout << "Building the file..." << std::endl;
                 filenames_list.push_back(nombre_temp);
                 FastaFile::FASTAFile ArchivoTemp(nombre_temp);
-                files_mainlist.push_back(ArchivoTemp);
+                files_mainlist.push_back(std::move(ArchivoTemp));
                 std::cout << "File loaded in memory!" << std::endl;
                 break;
             }
+            case 'I':
+            case 'i': {
+                std::cout << "What .fa file do you want to load?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                FastaFile::FASTAFile::benchmarkAllocations(nombre_temp);
+                break;
+            }
+            case 'H':
+            case 'h': {
+                std::cout << "Please put the file name" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                std::cout << "How many Sequences can stay in memory?" << std::endl;
+                size_t resident_limit = 1;
+                std::cin >> resident_limit;
+                filenames_list.push_back(nombre_temp);
+                FastaFile::FASTAFile ArchivoTemp(nombre_temp, DNA_sequence::AlphabetKind::Default, resident_limit);
+                files_mainlist.push_back(std::move(ArchivoTemp));
+                std::cout << "File opened!" << std::endl;
+                break;
+            }
             case '3': {
                 std::cout << "The loaded files are ... " << std::endl;
                 for (auto &iter: filenames_list) {
                     std::cout << "================" << std::endl;
                     std::cout << iter << std::endl;
                 }
+                std::cout << "In what file do you want to search?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                for (auto &archivo: files_mainlist) {
+                    if (archivo.fileName() == nombre_temp) {
+                        std::cout << "What subsequence?" << std::endl;
+                        std::string sub_sequence;
+                        std::cin >> sub_sequence;
+                        if (archivo.isLazy()) { // Only the Sequence searched is parsed.
+                            std::cout << "In what Sequence?" << std::endl;
+                            std::string sequence_name;
+                            std::cin >> sequence_name;
+                            std::vector<FastaFile::SearchMatch> matches = archivo.findSubSequence(sub_sequence,
+                                                                                                  sequence_name);
+                            std::cout << matches.size() << " matches found." << std::endl;
+                            for (size_t i = 0; i < matches.size() && i < 20; i++) {
+                                std::cout << sequence_name << " : " << matches[i].offset_ << std::endl;
+                            }
+                            if (matches.size() > 20) std::cout << "..." << std::endl;
+                            break;
+                        }
+                        std::vector<FastaFile::SearchMatch> matches = archivo.findSubSequence(sub_sequence);
+                        std::cout << matches.size() << " matches found." << std::endl;
+                        std::vector<std::string> names;
+                        for (auto &seqs: archivo.getSequencesList()) names.push_back(seqs.seq_name_);
+                        for (size_t i = 0; i < matches.size() && i < 20; i++) {
+                            std::cout << names[matches[i].sequence_] << " : " << matches[i].offset_ << std::endl;
+                        }
+                        if (matches.size() > 20) std::cout << "..." << std::endl;
+                        break;
+                    }
+                }
                 break;
             }
             case '4': {
@@ -114,9 +245,7 @@ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\
                 for (auto &archivo: files_mainlist) {
                     if (archivo.fileName() == nombre_temp) {
                         nombre_temp += +"_BIN_EXPORT";
-                        FastaFile::FASTAFile ArchivoTemp(archivo);
-                        ArchivoTemp.HuffmanEncodder();
-                        ArchivoTemp.compressFile(nombre_temp);
+                        archivo.compressFile(nombre_temp, askCodec()); // The loaded File is not modified.
                         std::cout << "Archivo comprimido y exportado!" << std::endl;
                         break;
                     }
@@ -124,6 +253,162 @@ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\
                 break;
             }
 
+            case '9': {
+                std::cout << "In what file do you want to search?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                for (auto &archivo: files_mainlist) {
+                    if (archivo.fileName() == nombre_temp) {
+                        std::cout << "What patterns file? (one pattern per line)" << std::endl;
+                        std::string patterns_file;
+                        std::cin >> patterns_file;
+                        std::cout << "Also the reverse complements? (y/n)" << std::endl;
+                        char reverse = 'n';
+                        std::cin >> reverse;
+                        std::vector<std::string> names;
+                        for (auto &seqs: archivo.getSequencesList()) names.push_back(seqs.seq_name_);
+                        for (auto &hits: archivo.batchSearch(patterns_file, reverse == 'y' || reverse == 'Y')) {
+                            std::cout << "================" << std::endl;
+                            std::cout << hits.name_ << (hits.reverse_ ? " (reverse complement) " : " ") << hits.pattern_
+                                      << " : " << hits.matches_.size() << " matches" << std::endl;
+                            for (size_t i = 0; i < hits.matches_.size() && i < 10; i++) {
+                                std::cout << "  " << names[hits.matches_[i].sequence_] << " : "
+                                          << hits.matches_[i].offset_ << std::endl;
+                            }
+                            if (hits.matches_.size() > 10) std::cout << "  ..." << std::endl;
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+
+            case 'A':
+            case 'a': {
+                std::cout << "What file do you want to mask?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                for (auto &archivo: files_mainlist) {
+                    if (archivo.fileName() == nombre_temp) {
+                        std::cout << "Subsequence or .bed file to mask?" << std::endl;
+                        std::string to_mask;
+                        std::cin >> to_mask;
+                        if (to_mask.size() > 4 && to_mask.substr(to_mask.size() - 4) == ".bed") {
+                            std::cout << "Soft-mask (lowercase)? (y/n)" << std::endl;
+                            char soft = 'n';
+                            std::cin >> soft;
+                            size_t masked = archivo.maskIntervals(to_mask, soft == 'y' || soft == 'Y');
+                            std::cout << masked << " bases masked." << std::endl;
+                        } else {
+                            std::cout << "Expand IUPAC codes (N = any base, case-insensitive)? (y/n)" << std::endl;
+                            char iupac = 'n';
+                            std::cin >> iupac;
+                            archivo.maskFile(to_mask, "X", iupac == 'y' || iupac == 'Y');
+                            std::cout << "File masked!" << std::endl;
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+            case 'B':
+            case 'b': {
+                std::cout << "What .fabin (or .fa) file?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                std::cout << "What region? (name:start-end)" << std::endl;
+                std::string region;
+                std::cin >> region;
+                std::string bases;
+                if (FastaFile::FASTAFile::fetchRegion(nombre_temp, region, bases)) {
+                    std::cout << ">" << region << std::endl;
+                    for (size_t i = 0; i < bases.size(); i += 60) std::cout << bases.substr(i, 60) << std::endl;
+                } else {
+                    std::cout << "Region not found... please check. " << std::endl;
+                }
+                break;
+            }
+
+            case 'C':
+            case 'c': {
+                std::cout << "What file do you want to benchmark?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                for (auto &archivo: files_mainlist) {
+                    if (archivo.fileName() == nombre_temp) {
+                        archivo.benchmarkScaling(askCodec());
+                        break;
+                    }
+                }
+                break;
+            }
+
+            case 'D':
+            case 'd': {
+                std::cout << "What .fa file do you want to compress?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                FastaFile::FabinCodec codec = askCodec();
+                char sampled = 'n';
+                if (FastaFile::codecUsesTable(codec)) {
+                    std::cout << "Take the frequencies from a sample (one pass less)? (y/n)" << std::endl;
+                    std::cin >> sampled;
+                }
+                std::string output = nombre_temp;
+                if (output.size() > 3 && output.substr(output.size() - 3) == ".fa") output.resize(output.size() - 3);
+                if (FastaFile::FASTAFile::compressStream(nombre_temp, output + "_BIN_EXPORT", codec,
+                                                         sampled == 'y' || sampled == 'Y')) {
+                    std::cout << "Archivo comprimido y exportado!" << std::endl;
+                }
+                break;
+            }
+
+            case 'E':
+            case 'e': {
+                std::cout << "What .fabin file do you want to decompress?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                std::string output = nombre_temp;
+                if (output.size() > 6 && output.substr(output.size() - 6) == ".fabin") output.resize(output.size() - 6);
+                if (FastaFile::FASTAFile::decompressStream(nombre_temp, output + "_export_FA")) {
+                    std::cout << "Successfully export! " << output << "_export_FA.fa" << std::endl;
+                }
+                break;
+            }
+
+            case 'F':
+            case 'f': {
+                std::cout << "What file do you want to export (.fa)?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                for (auto &archivo: files_mainlist) {
+                    if (archivo.fileName() == nombre_temp) {
+                        std::cout << "Bases per line? (0 = keep the lines)" << std::endl;
+                        size_t line_width = 0;
+                        std::cin >> line_width;
+                        std::cout << "Write a .fai index too? (y/n)" << std::endl;
+                        char fai = 'n';
+                        std::cin >> fai;
+                        std::string export_file_name = nombre_temp + "_export_FA.fa";
+                        if (archivo.exportFasta(export_file_name, line_width, fai == 'y' || fai == 'Y')) {
+                            std::cout << "Successfully export! " << export_file_name << std::endl;
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+
+            case 'G':
+            case 'g': {
+                std::cout << "What .fa file do you want to index?" << std::endl;
+                std::string nombre_temp;
+                std::cin >> nombre_temp;
+                long indexed = FastaFile::FASTAFile::buildFaiIndex(nombre_temp);
+                if (indexed >= 0) std::cout << indexed << " Sequences indexed." << std::endl;
+                break;
+            }
+
             case '8': {
                 std::cout << "Goodbye ... " << std::endl;
                 break;
@@ -137,21 +422,21 @@ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\ $$$$\
                     if (archivo.fileName() == nombre_temp) {
                         std::cout << "What Sequence?";
                         std::cin >> nombre_temp;
-                        for (auto seqs: archivo.getSequencesList()) {
-                            if (seqs.seq_name_ == nombre_temp) {
-                                int i, j, x, y;
-                                i = j = x = y = 0;
-                                std::cout << "The Sequence : " << seqs.seq_name_ << " founded." << std::endl;
-                                std::cout << "From what X coord? (Source)." << std::endl;
-                                std::cin >> i;
-                                std::cout << "From what Y coord? (Source)." << std::endl;
-                                std::cin >> j;
-                                std::cout << "To what X coord? (Destination)." << std::endl;
-                                std::cin >> x;
-                                std::cout << "To what Y coord? (Destination)." << std::endl;
-                                std::cin >> y;
-                                seqs.shortest(i, j, x, y);
-                            }
+                        std::shared_ptr<DNA_sequence::Sequence> found = archivo.sequence(nombre_temp);
+                        if (found) { // A lazy File only parses this Sequence.
+                            DNA_sequence::Sequence seqs = *found;
+                            int i, j, x, y;
+                            i = j = x = y = 0;
+                            std::cout << "The Sequence : " << seqs.seq_name_ << " founded." << std::endl;
+                            std::cout << "From what X coord? (Source)." << std::endl;
+                            std::cin >> i;
+                            std::cout << "From what Y coord? (Source)." << std::endl;
+                            std::cin >> j;
+                            std::cout << "To what X coord? (Destination)." << std::endl;
+                            std::cin >> x;
+                            std::cout << "To what Y coord? (Destination)." << std::endl;
+                            std::cin >> y;
+                            seqs.shortest(i, j, x, y);
                         }
                     }
                 }